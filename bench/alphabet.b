@@ -0,0 +1,10 @@
+Long output
+Prints the alphabet on each of a million lines for 27 megabytes in total
+
+>>>>>>>>>>>>>>>[-]++++++++++<<<<<<<<<<<<<<<[-]++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[>>>[-]+++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++[>>>[-]++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++[>>>[-]+++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++>>>[-]++++++++++
+++++++++++++++++[<<<.+>>>-]>>>.<<<<<<<<<-]<<<-]<<<-]
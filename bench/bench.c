@@ -0,0 +1,504 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BRAINFUCK_BENCH_MEMORY_SIZE 30000
+#define BRAINFUCK_BENCH_MAX_PATH_LENGTH 4096
+#define BRAINFUCK_BENCH_READ_SIZE 65536
+#define BRAINFUCK_BENCH_HASH_BASIS 0xCBF29CE484222325
+
+/**
+ * @brief A program of the benchmark suite.
+ */
+struct brainfuck_bench_workload {
+  const char *name;  /* The name it is reported under. */
+  const char *file;  /* The program, in the directory of the suite. */
+  size_t input_size; /* The bytes of generated text it reads, 0 for none. */
+};
+
+/**
+ * @brief A way of running IBF that the suite measures.
+ */
+struct brainfuck_bench_engine {
+  const char *name;         /* The name it is reported under. */
+  const char *const *flags; /* The options passed to IBF, NULL-terminated. */
+};
+
+/**
+ * @brief What a reference run of a workload produces, which every engine is
+ * checked against.
+ */
+struct brainfuck_bench_expected {
+  uint64_t instructions; /* The brainfuck instructions executed. */
+  uint64_t output_hash;  /* The hash of the output. */
+  size_t output_size;    /* The bytes of the output. */
+};
+
+/**
+ * @brief What a run of IBF is measured at.
+ */
+struct brainfuck_bench_result {
+  double seconds;       /* The wall time of the run. */
+  long peak_rss;        /* The peak resident set size, in KiB. */
+  int status;           /* The exit status, or -1 if it did not exit. */
+  uint64_t output_hash; /* The hash of the output. */
+  size_t output_size;   /* The bytes of the output. */
+};
+
+static const struct brainfuck_bench_workload brainfuck_bench_workloads[] = {
+    {"mandelbrot", "mandelbrot.b", 0},
+    {"hanoi", "hanoi.b", 0},
+    {"sieve", "sieve.b", 0},
+    {"long_output", "alphabet.b", 0},
+    {"long_input", "rot13.b", 1 << 20},
+};
+
+static const char *const brainfuck_bench_reference_flags[] = {
+    "--engine", "switch", "-O", "0", NULL};
+static const char *const brainfuck_bench_threaded_flags[] = {
+    "--engine", "threaded", "-O", "0", NULL};
+static const char *const brainfuck_bench_optimized_flags[] = {
+    "--engine", "threaded", "-O", "2", NULL};
+static const char *const brainfuck_bench_jit_flags[] = {
+    "--engine", "jit", "-O", "2", NULL};
+
+static const struct brainfuck_bench_engine brainfuck_bench_engines[] = {
+    {"reference", brainfuck_bench_reference_flags},
+    {"threaded", brainfuck_bench_threaded_flags},
+    {"optimized", brainfuck_bench_optimized_flags},
+    {"jit", brainfuck_bench_jit_flags},
+};
+
+/**
+ * @brief Hash bytes with 64-bit FNV-1a, continuing from a previous hash.
+ * @param hash The hash so far, or the offset basis to start with.
+ * @param bytes The bytes to hash.
+ * @param length The number of bytes.
+ * @return The hash including the bytes.
+ */
+uint64_t brainfuck_bench_hash(uint64_t hash, const uint8_t *bytes,
+                              size_t length) {
+  for (size_t i = 0; i < length; i += 1) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3;
+  }
+  return hash;
+}
+
+/**
+ * @brief Get the time of a monotonic clock.
+ * @return The time in seconds.
+ */
+double brainfuck_bench_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Read a whole file.
+ * @param path The path of the file.
+ * @param length Set to the number of bytes read.
+ * @return The bytes, NUL-terminated, or NULL if the file cannot be read.
+ */
+char *brainfuck_bench_read(const char *path, size_t *length) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  size_t capacity = BRAINFUCK_BENCH_READ_SIZE;
+  size_t size = 0;
+  char *bytes = malloc(capacity);
+  while (bytes != NULL) {
+    size += fread(bytes + size, 1, capacity - size - 1, file);
+    if (size < capacity - 1) {
+      break;
+    }
+    capacity *= 2;
+    char *grown = realloc(bytes, capacity);
+    if (grown == NULL) {
+      free(bytes);
+    }
+    bytes = grown;
+  }
+  bool failed = ferror(file) != 0;
+  fclose(file);
+  if (bytes == NULL || failed) {
+    free(bytes);
+    return NULL;
+  }
+  bytes[size] = '\0';
+  *length = size;
+  return bytes;
+}
+
+/**
+ * @brief Generate the text a workload reads: words of letters, digits and
+ * punctuation in lines, the same on every run.
+ * @param size The bytes to generate.
+ * @return The text, or NULL if it cannot be allocated.
+ */
+uint8_t *brainfuck_bench_text(size_t size) {
+  static const char alphabet[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,;!?";
+  uint8_t *text = malloc(size);
+  if (text == NULL) {
+    return NULL;
+  }
+  uint64_t seed = 0x9E3779B97F4A7C15;
+  for (size_t i = 0; i < size; i += 1) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    uint32_t value = (uint32_t)(seed >> 33);
+    if (i % 64 == 63) {
+      text[i] = '\n';
+    } else if (value % 7 == 0) {
+      text[i] = ' ';
+    } else {
+      text[i] = (uint8_t)alphabet[value % (sizeof(alphabet) - 1)];
+    }
+  }
+  return text;
+}
+
+/**
+ * @brief An instruction of the reference interpreter, where a run of the
+ * same `+`, `-`, `<` or `>` is one instruction that counts as many.
+ */
+struct brainfuck_bench_instruction {
+  char token;     /* The brainfuck instruction. */
+  uint32_t count; /* The instructions it stands for. */
+  size_t jump;    /* The index of the matching bracket of a loop. */
+};
+
+/**
+ * @brief Run a program with a plain interpreter that counts every
+ * brainfuck instruction it executes, on a wrapping tape of 30000 cells
+ * where `,` leaves the cell unchanged at the end of the input.
+ * @param src The program.
+ * @param length The length of the program.
+ * @param input The input of the program.
+ * @param input_size The bytes of the input.
+ * @param expected Set to the instructions and output of the run.
+ * @return False if the loops of the program do not match.
+ */
+bool brainfuck_bench_reference(const char *src, size_t length,
+                               const uint8_t *input, size_t input_size,
+                               struct brainfuck_bench_expected *expected) {
+  struct brainfuck_bench_instruction *code =
+      malloc(sizeof(struct brainfuck_bench_instruction) * (length + 1));
+  size_t *stack = malloc(sizeof(size_t) * (length + 1));
+  uint8_t *memory = calloc(BRAINFUCK_BENCH_MEMORY_SIZE, 1);
+  bool success = code != NULL && stack != NULL && memory != NULL;
+  size_t size = 0;
+  size_t depth = 0;
+  for (size_t i = 0; success && i < length; i += 1) {
+    char token = src[i];
+    if (token == '\0' || strchr("+-<>.,[]", token) == NULL) {
+      continue;
+    }
+    if (size > 0 && code[size - 1].token == token &&
+        strchr("+-<>", token) != NULL) {
+      code[size - 1].count += 1;
+      continue;
+    }
+    code[size] = (struct brainfuck_bench_instruction){token, 1, 0};
+    if (token == '[') {
+      stack[depth] = size;
+      depth += 1;
+    } else if (token == ']') {
+      if (depth == 0) {
+        success = false;
+        break;
+      }
+      depth -= 1;
+      code[size].jump = stack[depth];
+      code[stack[depth]].jump = size;
+    }
+    size += 1;
+  }
+  success = success && depth == 0;
+  uint64_t instructions = 0;
+  uint64_t hash = BRAINFUCK_BENCH_HASH_BASIS;
+  size_t output_size = 0;
+  size_t pointer = 0;
+  size_t read = 0;
+  for (size_t pc = 0; success && pc < size; pc += 1) {
+    const struct brainfuck_bench_instruction *instruction = &code[pc];
+    instructions += instruction->count;
+    switch (instruction->token) {
+      case '+':
+        memory[pointer] += (uint8_t)instruction->count;
+        break;
+      case '-':
+        memory[pointer] -= (uint8_t)instruction->count;
+        break;
+      case '>':
+        pointer = (pointer + instruction->count) % BRAINFUCK_BENCH_MEMORY_SIZE;
+        break;
+      case '<':
+        pointer = (pointer + BRAINFUCK_BENCH_MEMORY_SIZE -
+                   instruction->count % BRAINFUCK_BENCH_MEMORY_SIZE) %
+                  BRAINFUCK_BENCH_MEMORY_SIZE;
+        break;
+      case '.':
+        hash = brainfuck_bench_hash(hash, &memory[pointer], 1);
+        output_size += 1;
+        break;
+      case ',':
+        if (read < input_size) {
+          memory[pointer] = input[read];
+          read += 1;
+        }
+        break;
+      case '[':
+        if (memory[pointer] == 0) {
+          pc = instruction->jump;
+        }
+        break;
+      case ']':
+        if (memory[pointer] != 0) {
+          pc = instruction->jump;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  expected->instructions = instructions;
+  expected->output_hash = hash;
+  expected->output_size = output_size;
+  free(code);
+  free(stack);
+  free(memory);
+  return success;
+}
+
+/**
+ * @brief Run IBF on a program, hashing its output as it arrives.
+ * @param ibf The path of IBF.
+ * @param flags The options passed to IBF, NULL-terminated.
+ * @param program The path of the program.
+ * @param input The file the program reads, or -1 for none.
+ * @param result Set to the measurements of the run.
+ * @return False if IBF cannot be started.
+ */
+bool brainfuck_bench_run(const char *ibf, const char *const *flags,
+                         const char *program, int input,
+                         struct brainfuck_bench_result *result) {
+  const char *argv[16];
+  size_t argc = 0;
+  argv[argc++] = ibf;
+  argv[argc++] = "--eof";
+  argv[argc++] = "unchanged";
+  for (size_t i = 0; flags[i] != NULL && argc < 14; i += 1) {
+    argv[argc++] = flags[i];
+  }
+  argv[argc++] = program;
+  argv[argc] = NULL;
+  int output[2];
+  if (pipe(output) != 0) {
+    return false;
+  }
+  if (input >= 0 && lseek(input, 0, SEEK_SET) != 0) {
+    close(output[0]);
+    close(output[1]);
+    return false;
+  }
+  double start = brainfuck_bench_clock();
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(output[0]);
+    close(output[1]);
+    return false;
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_RDONLY);
+    dup2(input >= 0 ? input : null, STDIN_FILENO);
+    dup2(output[1], STDOUT_FILENO);
+    close(output[0]);
+    close(output[1]);
+    execv(ibf, (char *const *)argv);
+    _exit(127);
+  }
+  close(output[1]);
+  static uint8_t buffer[BRAINFUCK_BENCH_READ_SIZE];
+  result->output_hash = BRAINFUCK_BENCH_HASH_BASIS;
+  result->output_size = 0;
+  for (;;) {
+    ssize_t length = read(output[0], buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      break;
+    }
+    result->output_hash =
+        brainfuck_bench_hash(result->output_hash, buffer, (size_t)length);
+    result->output_size += (size_t)length;
+  }
+  close(output[0]);
+  int status = 0;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  result->seconds = brainfuck_bench_clock() - start;
+  result->peak_rss = usage.ru_maxrss;
+  result->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return true;
+}
+
+/**
+ * @brief Write the generated input of a workload to a temporary file.
+ * @param size The bytes of the input.
+ * @return The file, at its start, or -1 if it cannot be written.
+ */
+int brainfuck_bench_input(size_t size) {
+  uint8_t *text = brainfuck_bench_text(size);
+  FILE *file = tmpfile();
+  if (text == NULL || file == NULL ||
+      fwrite(text, 1, size, file) != size || fflush(file) != 0) {
+    free(text);
+    if (file != NULL) {
+      fclose(file);
+    }
+    return -1;
+  }
+  free(text);
+  /* The descriptor outlives the stream, and the file is deleted with it. */
+  int input = dup(fileno(file));
+  fclose(file);
+  return input;
+}
+
+/**
+ * @brief Measure every engine on a workload, writing one JSON object per
+ * line to the standard output.
+ * @param ibf The path of IBF.
+ * @param directory The directory of the suite.
+ * @param workload The workload.
+ * @param runs The runs of every engine, of which the fastest is reported.
+ * @return True if every engine matches the reference run.
+ */
+bool brainfuck_bench_workload(const char *ibf, const char *directory,
+                              const struct brainfuck_bench_workload *workload,
+                              int runs) {
+  char path[BRAINFUCK_BENCH_MAX_PATH_LENGTH];
+  snprintf(path, sizeof(path), "%s/%s", directory, workload->file);
+  size_t length = 0;
+  char *src = brainfuck_bench_read(path, &length);
+  if (src == NULL) {
+    fprintf(stderr, "IOError: cannot read %s.\n", path);
+    return false;
+  }
+  int input = -1;
+  uint8_t *text = NULL;
+  if (workload->input_size > 0) {
+    text = brainfuck_bench_text(workload->input_size);
+    input = brainfuck_bench_input(workload->input_size);
+    if (text == NULL || input < 0) {
+      fprintf(stderr, "IOError: cannot generate the input of %s.\n",
+              workload->name);
+      free(text);
+      free(src);
+      return false;
+    }
+  }
+  struct brainfuck_bench_expected expected;
+  bool success = brainfuck_bench_reference(src, length, text,
+                                           workload->input_size, &expected);
+  free(text);
+  free(src);
+  if (!success) {
+    fprintf(stderr, "SyntaxError: unmatched loop in %s.\n", path);
+  }
+  size_t engines =
+      sizeof(brainfuck_bench_engines) / sizeof(brainfuck_bench_engines[0]);
+  for (size_t i = 0; success && i < engines; i += 1) {
+    const struct brainfuck_bench_engine *engine = &brainfuck_bench_engines[i];
+    struct brainfuck_bench_result best = {0};
+    bool matched = true;
+    for (int run = 0; run < runs; run += 1) {
+      struct brainfuck_bench_result result;
+      if (!brainfuck_bench_run(ibf, engine->flags, path, input, &result)) {
+        fprintf(stderr, "IOError: cannot run %s.\n", ibf);
+        success = false;
+        break;
+      }
+      matched = matched && result.status == 0 &&
+                result.output_hash == expected.output_hash &&
+                result.output_size == expected.output_size;
+      if (run == 0 || result.seconds < best.seconds) {
+        best = result;
+      }
+    }
+    if (!success) {
+      break;
+    }
+    printf("{\"workload\": \"%s\", \"engine\": \"%s\", \"runs\": %d, "
+           "\"seconds\": %.6f, \"instructions\": %llu, "
+           "\"instructions_per_second\": %.0f, \"peak_rss_kib\": %ld, "
+           "\"status\": %d, \"output_matches\": %s}\n",
+           workload->name, engine->name, runs, best.seconds,
+           (unsigned long long)expected.instructions,
+           best.seconds > 0 ? (double)expected.instructions / best.seconds
+                            : 0.0,
+           best.peak_rss, best.status, matched ? "true" : "false");
+    fflush(stdout);
+    success = matched;
+  }
+  if (input >= 0) {
+    close(input);
+  }
+  return success;
+}
+
+/**
+ * @brief Print the usage of the benchmark suite.
+ */
+void brainfuck_bench_usage() {
+  fprintf(stderr,
+          "usage: bench [-n runs] ibf directory [workload] ...\n"
+          "Runs the workloads of the suite in the directory, or the named\n"
+          "ones, on every engine of IBF, writing a JSON object per line.\n");
+}
+
+int main(int argc, char *argv[]) {
+  int runs = 1;
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+    runs = atoi(argv[2]);
+    first = 3;
+  }
+  if (runs < 1 || argc - first < 2) {
+    brainfuck_bench_usage();
+    return EXIT_FAILURE;
+  }
+  const char *ibf = argv[first];
+  const char *directory = argv[first + 1];
+  size_t workloads =
+      sizeof(brainfuck_bench_workloads) / sizeof(brainfuck_bench_workloads[0]);
+  bool success = true;
+  for (size_t i = 0; i < workloads; i += 1) {
+    const struct brainfuck_bench_workload *workload =
+        &brainfuck_bench_workloads[i];
+    bool selected = argc - first == 2;
+    for (int j = first + 2; j < argc; j += 1) {
+      selected = selected || strcmp(argv[j], workload->name) == 0;
+    }
+    if (selected && !brainfuck_bench_workload(ibf, directory, workload, runs)) {
+      success = false;
+    }
+  }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,9 @@
+ROT13
+Rotates the letters of its input by 13 and copies every other byte
+It reads until the end of the input with the cell left unchanged or set
+to 255 and its input must not hold byte 255
+This is the example from the Wikipedia article on brainfuck
+
+-,+[-[>>++++[>++++++++<-]<+<-[>+>+>-[>>>]<[[>+<-]>>+>]<<<<<-]]>>>[-]+>--[-[<->++
++[-]]]<[++++++++++++<[>-[>+>>]>[+[<+>-]>+>>]<<<<<-]>>[<+>-]>[-[-<<[-]>>]<<[<<->>
+-]>>]<<[<<+>>-]]<[-]<.[-]<-,+]
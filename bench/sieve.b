@@ -0,0 +1,34 @@
+Sieve of Eratosthenes
+Prints the primes below 3000 one per line
+The numbers are a row of 9 cell records which the marking of every prime
+below 256 walks carrying a countdown and which a scan back to the start
+returns from
+The marking is repeated 4 times so that it dominates the run
+
+>>>>>>>>>>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++>++++++++++++++++++++++++++++++[<<<<+>+>>->>+<<[
+>>-<<[->>>+<<<]]>>>[-<<<+>>>]<[<<+++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++>->-]<<[->>>>>>>>>+<<<<<<<<
+<]>[->>>>>>>>>+<<<<<<<<<]>>>>>>>>>]<[-]<<<<<<<<<<<[<<<<<<<<<]>>>>>>>>>>+>>>>>>>>
+>+<<<<<<<<<<<<<++++[>>>>>>>>>>>>>>>>>>>>>>>>>>>++>++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[<<<+<<<[>>>-<<<
+[->>>>+<<<<]]>>>>[-<<<<+>>>>]<[->>[-<<<<+>+>>+>]<[->+<]<<<<<-<[>>>[->>>>>>>>>+<<
+<<<<<<<]>[->>>>>>>>>+<<<<<<<<<]>>>>>>>>->>+<<[>>-<<[->>>+<<<]]>>>[-<<<+>>>]<[-<<
+<[-]+>>[-<+>>>+<<]>>[-<<+>>]<]<<<<<]>>>[-]>[-]<<<<<<<<<<<<[<<<<<<<<<]+>>>>]>>[->
+>>>>>>>>+<<<<<<<<<]>>>>>>>>>+<<<<<<<<[->>>>>>>>>+<<<<<<<<<]>>>>>>>>>-]<[-]<<<<<<
+<<<<<<<<<[<<<<<<<<<]>>>>>>-]>>[>>>>>+<<<[>>>-<<<[->>>>+<<<<]]>>>>[-<<<<+>>>>]<[-
+<<<<[-]>>>>>>>[-<<<+>+>>]<<[->>+<<]<[<<<<[-]+>>>>[-]]<<<<[->>>>+>+<<<<<]>>>>>[-<
+<<<<+>>>>>]<[>>>++++++++++++++++++++++++++++++++++++++++++++++++.---------------
+---------------------------------<<<[-]]>>[-<<+>+>]<[->+<]<[<<<<[-]+>>>>[-]]<<<<
+[->>>>+>+<<<<<]>>>>>[-<<<<<+>>>>>]<[>>++++++++++++++++++++++++++++++++++++++++++
+++++++.------------------------------------------------<<[-]]<[->+>+<<]>>[-<<+>>
+]<[<<<<[-]+>>>>[-]]<<<<[->>>>+>+<<<<<]>>>>>[-<<<<<+>>>>>]<[<++++++++++++++++++++
+++++++++++++++++++++++++++++.------------------------------------------------>[-
+]]<<++++++++++++++++++++++++++++++++++++++++++++++++.---------------------------
+--------------------->>>++++++++++.[-]<<<<<[-]>>>>]<<+[->>+>+<<<]>>>[-<<<+>>>]<-
+--------->+<[>-<[-]]>[-<<<[-]>+[->+>+<<]>>[-<<+>>]<---------->+<[>-<[-]]>[-<<[-]
+>>>+[-<<+>+>]<[->+<]<---------->+<[>-<[-]]>[->[-]>+[-<<<+>+>>]<<[->>+<<]<-------
+--->+<[>-<[-]]>[->>[-]<<]]]]<<<[->>>>>>>>>+<<<<<<<<<]>[->>>>>>>>>+<<<<<<<<<]>>>[
+->>>>>>>>>+<<<<<<<<<]>[->>>>>>>>>+<<<<<<<<<]>]>>>[-]>[-]>>>[-]>[-]
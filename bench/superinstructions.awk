@@ -0,0 +1,84 @@
+# Choose the superinstructions of the threaded engine from the reports of
+# `ibf --profile`, read one after the other, and write them as the lines of
+# superinstructions.def. A sequence scores the dispatches it saves in each
+# program as a share of the instructions that program executed, so every
+# workload weighs the same. A loop start or end jumps, so it can only end a
+# superinstruction.
+
+BEGIN {
+  limit = 12
+}
+
+/^Profile: / {
+  total = $2
+  sequences = 0
+  next
+}
+
+/^Hottest sequences:/ {
+  sequences = 1
+  getline # the heading
+  next
+}
+
+/^[^ ]/ {
+  sequences = 0
+}
+
+sequences && total > 0 {
+  count = $1
+  names = $0
+  sub(/^ *[0-9]+ +[0-9.]+% +/, "", names)
+  length_ = split(names, opcodes, / \+ /)
+  key = ""
+  valid = 1
+  for (i = 1; i <= length_; i += 1) {
+    opcode = toupper(opcodes[i])
+    gsub(/ /, "_", opcode)
+    if (i < length_ && opcode ~ /^LOOP_/) {
+      valid = 0
+    }
+    key = key (i > 1 ? ", " : "") opcode
+  }
+  if (valid) {
+    score[key] += count * (length_ - 1) / total
+    size[key] = length_
+  }
+}
+
+END {
+  print "/* The superinstructions of the threaded engine, longest first. This"
+  print " * file is generated by `make superinstructions` from the profile of"
+  print " * the workloads of bench/. */"
+  chosen = 0
+  while (chosen < limit) {
+    best = ""
+    for (key in score) {
+      if (best == "" || score[key] > score[best]) {
+        best = key
+      }
+    }
+    if (best == "") {
+      break
+    }
+    picked[best] = score[best]
+    delete score[best]
+    chosen += 1
+  }
+  for (length_ = 3; length_ >= 2; length_ -= 1) {
+    while (1) {
+      best = ""
+      for (key in picked) {
+        if (size[key] == length_ &&
+            (best == "" || picked[key] > picked[best])) {
+          best = key
+        }
+      }
+      if (best == "") {
+        break
+      }
+      printf "BRAINFUCK_SUPERINSTRUCTION%d(%s)\n", length_, best
+      delete picked[best]
+    }
+  }
+}
@@ -1,385 +1,75 @@
+#include "ibf.h"
+
+#include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define BRAINFUCK_TOKEN_PLUS '+'
-#define BRAINFUCK_TOKEN_MINUS '-'
-#define BRAINFUCK_TOKEN_PREVIOUS '<'
-#define BRAINFUCK_TOKEN_NEXT '>'
-#define BRAINFUCK_TOKEN_OUTPUT '.'
-#define BRAINFUCK_TOKEN_INPUT ','
-#define BRAINFUCK_TOKEN_LOOP_START '['
-#define BRAINFUCK_TOKEN_LOOP_END ']'
-
-#define BRAINFUCK_MEMORY_BUFFER_SIZE 30000
-#define BRAINFUCK_LOOP_BUFFER_SIZE 100000
-#define BRAINFUCK_MAX_LINE_LENGTH 100000
-#define BRAINFUCK_MAX_LOOP_DEPTH 65536
-
-/**
- * @brief The input handler of IBF.
- * @return The character to input.
- */
-typedef uint8_t (*brainfuck_input_handler)();
-
-/**
- * @brief The output handler of IBF.
- * @param c The character to output.
- */
-typedef void (*brainfuck_output_handler)(uint8_t c);
-
-/**
- * @brief The state of IBF.
- */
-struct brainfuck_state {
-  uint8_t *memory_buffer; /* The memory buffer. */
-  size_t memory_pointer;  /* The memory pointer. */
-  char *loop_buffer;      /* The loop buffer. */
-  size_t loop_size;       /* The loop size. */
-  size_t unmatched_depth; /* The unmatched depth of loop. */
-};
-
-/**
- * @brief The context of IBF.
- */
-struct brainfuck_context {
-  struct brainfuck_state *state;           /* The state of IBF. */
-  brainfuck_input_handler input_handler;   /* The input handler of IBF. */
-  brainfuck_output_handler output_handler; /* The output handler of IBF. */
-};
-
-/**
- * @brief Create a new state of IBF.
- * @return The new state of IBF.
- */
-struct brainfuck_state *brainfuck_state_new() {
-  struct brainfuck_state *state = malloc(sizeof(struct brainfuck_state));
-  state->memory_buffer = calloc(BRAINFUCK_MEMORY_BUFFER_SIZE, sizeof(uint8_t));
-  state->memory_pointer = 0;
-  state->loop_buffer = calloc(BRAINFUCK_LOOP_BUFFER_SIZE, sizeof(char));
-  state->loop_size = 0;
-  state->unmatched_depth = 0;
-  return state;
-}
-
-/**
- * @brief Free the state of IBF.
- * @param state The state of IBF.
- */
-void brainfuck_state_free(struct brainfuck_state *state) {
-  if (state == NULL) {
-    return;
-  }
-  free(state->memory_buffer);
-  free(state->loop_buffer);
-  free(state);
-}
-
-/**
- * @brief Create a new context of IBF.
- * @param input_handler The input handler of IBF.
- * @param output_handler The output handler of IBF.
- * @return The new context of IBF.
- */
-struct brainfuck_context *brainfuck_context_new(
-    brainfuck_input_handler input_handler,
-    brainfuck_output_handler output_handler) {
-  struct brainfuck_context *context = malloc(sizeof(struct brainfuck_context));
-  context->state = brainfuck_state_new();
-  context->output_handler = output_handler;
-  context->input_handler = input_handler;
-  return context;
-}
-
-/**
- * @brief Free the context of IBF.
- * @param context The context of IBF.
- */
-void brainfuck_context_free(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  brainfuck_state_free(context->state);
-  free(context);
-}
-
-void print_error_unmatched_loop_end() {
-  fprintf(stderr, "SyntaxError: unmatched ']'.\n");
-}
-
-void print_error_unmatched_loop_start() {
-  fprintf(stderr, "SyntaxError: unmatched '['.\n");
-}
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32)
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define BRAINFUCK_HAVE_MMAP
+#define BRAINFUCK_HAVE_THREADS
+#endif
 
-void print_error_max_loop_depth() {
-  fprintf(stderr, "LoopError: maximum loop depth exceeded.\n");
-}
+#define BRAINFUCK_MAX_LINE_LENGTH 100000
+#define BRAINFUCK_OUTPUT_BUFFER_SIZE 65536
+#define BRAINFUCK_INPUT_BUFFER_SIZE 65536
+#define BRAINFUCK_MAX_PATH_LENGTH 4096
+#define BRAINFUCK_EXIT_LIMIT 3
 
 void print_error_max_line_length() {
   fprintf(stderr, "InputError: max line length exceeded.\n");
 }
 
-void print_error_max_loop_size() {
-  fprintf(stderr, "LoopError: maximum loop size exceeded.\n");
+void print_error_tape_allocation() {
+  fprintf(stderr, "MemoryError: cannot allocate the memory tape.\n");
 }
 
-void print_error_unexpected_eof() {
-  fprintf(stderr, "IOError: unexpected EOF.\n");
+void print_error_emit_tape() {
+  fprintf(stderr, "EmitError: only a fixed tape can be translated.\n");
 }
 
-/**
- * @brief Execute the plus instruction `+` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_plus(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  context->state->memory_buffer[context->state->memory_pointer] += 1;
+void print_error_unexpected_eof() {
+  fprintf(stderr, "IOError: unexpected EOF.\n");
 }
 
-/**
- * @brief Execute the minus instruction `-` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_minus(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  context->state->memory_buffer[context->state->memory_pointer] -= 1;
+void print_error_read_source() {
+  fprintf(stderr, "IOError: cannot read the program.\n");
 }
 
-/**
- * @brief Execute the previous instruction `<` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_previous(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  if (context->state->memory_pointer == 0) {
-    context->state->memory_pointer = BRAINFUCK_MEMORY_BUFFER_SIZE - 1;
-  } else {
-    context->state->memory_pointer -= 1;
-  }
+void print_error_read_input() {
+  fprintf(stderr, "IOError: cannot read the input.\n");
 }
 
-/**
- * @brief Execute the next instruction `>` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_next(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  if (context->state->memory_pointer == BRAINFUCK_MEMORY_BUFFER_SIZE - 1) {
-    context->state->memory_pointer = 0;
-  } else {
-    context->state->memory_pointer += 1;
-  }
+void print_error_write_output() {
+  fprintf(stderr, "IOError: cannot write the output.\n");
 }
 
-/**
- * @brief Execute the input instruction `,` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_input(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  context->state->memory_buffer[context->state->memory_pointer] =
-      context->input_handler();
+void print_error_step_limit() {
+  fprintf(stderr, "LimitError: step limit exceeded.\n");
 }
 
-/**
- * @brief Execute the output instruction `.` of brainfuck.
- * @param context The context of IBF.
- */
-void brainfuck_execute_output(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return;
-  }
-  context->output_handler(
-      context->state->memory_buffer[context->state->memory_pointer]);
+void print_error_time_limit() {
+  fprintf(stderr, "LimitError: time limit exceeded.\n");
 }
 
-bool brainfuck_loop_enque(struct brainfuck_context *context, char c) {
-  if (context == NULL) {
-    return false;
-  }
-  if (context->state->loop_size == BRAINFUCK_LOOP_BUFFER_SIZE) {
-    print_error_max_loop_size();
-    return false;
-  }
-  context->state->loop_buffer[context->state->loop_size] = c;
-  context->state->loop_size += 1;
-  return true;
+void print_error_compiled_program() {
+  fprintf(stderr, "LoadError: invalid or incompatible compiled program.\n");
 }
 
-bool brainfuck_loop_increase_unmatched(struct brainfuck_context *context) {
-  if (context == NULL) {
-    return false;
-  }
-  if (context->state->unmatched_depth == BRAINFUCK_MAX_LOOP_DEPTH) {
-    print_error_max_loop_depth();
-    return false;
-  }
-  context->state->unmatched_depth += 1;
-  return true;
+void print_error_program_allocation() {
+  fprintf(stderr, "MemoryError: cannot allocate the program.\n");
 }
 
-void brainfuck_loop_execute(struct brainfuck_context *context) {
-  if (context == NULL || context->state->loop_size == 0) {
-    return;
-  }
-  if (context->state->memory_buffer[context->state->memory_pointer] == 0) {
-    context->state->loop_size = 0;
-    return;
-  }
-  size_t *loop_stack = malloc(sizeof(size_t) * BRAINFUCK_MAX_LOOP_DEPTH);
-  size_t loop_stack_size = 0;
-  size_t execute_pointer = 0;
-  while (execute_pointer < context->state->loop_size) {
-    if (context->state->loop_buffer[execute_pointer] ==
-        BRAINFUCK_TOKEN_LOOP_START) {
-      if (context->state->memory_buffer[context->state->memory_pointer] ==
-          0) {  // skip the loop if value is zero.
-        size_t unmatched_depth = 1;
-        execute_pointer += 1;
-        while (unmatched_depth > 0) {
-          if (context->state->loop_buffer[execute_pointer] ==
-              BRAINFUCK_TOKEN_LOOP_START) {
-            unmatched_depth += 1;
-          } else if (context->state->loop_buffer[execute_pointer] ==
-                     BRAINFUCK_TOKEN_LOOP_END) {
-            unmatched_depth -= 1;
-          }
-          execute_pointer += 1;
-        }
-      } else {  // if value is not zero, then execute the loop.
-        loop_stack[loop_stack_size] = execute_pointer;
-        loop_stack_size += 1;
-        execute_pointer += 1;
-      }
-    } else if (context->state->loop_buffer[execute_pointer] ==
-               BRAINFUCK_TOKEN_LOOP_END) {
-      if (context->state->memory_buffer[context->state->memory_pointer] != 0) {
-        execute_pointer = loop_stack[loop_stack_size - 1] + 1;
-      } else {
-        loop_stack_size -= 1;
-        execute_pointer += 1;
-      }
-    } else {
-      switch (context->state->loop_buffer[execute_pointer]) {
-        case BRAINFUCK_TOKEN_PLUS:
-          brainfuck_execute_plus(context);
-          break;
-        case BRAINFUCK_TOKEN_MINUS:
-          brainfuck_execute_minus(context);
-          break;
-        case BRAINFUCK_TOKEN_PREVIOUS:
-          brainfuck_execute_previous(context);
-          break;
-        case BRAINFUCK_TOKEN_NEXT:
-          brainfuck_execute_next(context);
-          break;
-        case BRAINFUCK_TOKEN_INPUT:
-          brainfuck_execute_input(context);
-          break;
-        case BRAINFUCK_TOKEN_OUTPUT:
-          brainfuck_execute_output(context);
-          break;
-        default:
-          break;
-      }
-      execute_pointer += 1;
-    }
-  }
-  context->state->loop_size = 0;
-  free(loop_stack);
+void print_error_snapshot_allocation() {
+  fprintf(stderr, "MemoryError: cannot allocate the snapshot.\n");
 }
 
-/**
- * @brief Excute a line of brainfuck code.
- * @param context The context of IBF.
- * @param src A line of brainfuck code to execute.
- * @return True if the line is executed successfully, false otherwise.
- */
-bool brainfuck_main(struct brainfuck_context *context, char *src) {
-  if (context == NULL || src == NULL) {
-    return false;
-  }
-  for (size_t i = 0; src[i] != '0'; i += 1) {
-    /* If the unmatched depth is 0, we can execute the instruction. */
-    if (context->state->unmatched_depth == 0) {
-      switch (src[i]) {
-        case BRAINFUCK_TOKEN_PLUS:
-          brainfuck_execute_plus(context);
-          break;
-        case BRAINFUCK_TOKEN_MINUS:
-          brainfuck_execute_minus(context);
-          break;
-        case BRAINFUCK_TOKEN_PREVIOUS:
-          brainfuck_execute_previous(context);
-          break;
-        case BRAINFUCK_TOKEN_NEXT:
-          brainfuck_execute_next(context);
-          break;
-        case BRAINFUCK_TOKEN_INPUT:
-          brainfuck_execute_input(context);
-          break;
-        case BRAINFUCK_TOKEN_OUTPUT:
-          brainfuck_execute_output(context);
-          break;
-        case BRAINFUCK_TOKEN_LOOP_START:
-          if (!brainfuck_loop_increase_unmatched(context)) {
-            return false;
-          }
-          brainfuck_loop_enque(context, src[i]);
-          break;
-        case BRAINFUCK_TOKEN_LOOP_END:
-          print_error_unmatched_loop_end();
-          return false;
-        default:
-          break;
-      }
-    } else {
-      /* If the unmatched depth is not 0, we can only record the instruction. */
-      switch (src[i]) {
-        case BRAINFUCK_TOKEN_PLUS:
-        case BRAINFUCK_TOKEN_MINUS:
-        case BRAINFUCK_TOKEN_PREVIOUS:
-        case BRAINFUCK_TOKEN_NEXT:
-        case BRAINFUCK_TOKEN_INPUT:
-        case BRAINFUCK_TOKEN_OUTPUT:
-          brainfuck_loop_enque(context, src[i]);
-          break;
-        case BRAINFUCK_TOKEN_LOOP_START:
-          if (!brainfuck_loop_increase_unmatched(context)) {
-            return false;
-          }
-          brainfuck_loop_enque(context, src[i]);
-          break;
-        case BRAINFUCK_TOKEN_LOOP_END:
-          context->state->unmatched_depth -= 1;
-          if (!brainfuck_loop_enque(context, src[i])) {
-            return false;
-          }
-          if (context->state->unmatched_depth == 0) {
-            /* If the unmatched depth is 0, we can execute the loop. */
-            brainfuck_loop_execute(context);
-          }
-          break;
-        default:
-          break;
-      }
-    }
-  }
-  return true;
+void print_error_no_snapshot() {
+  fprintf(stderr, "SnapshotError: nothing saved to restore.\n");
 }
 
 /**
@@ -419,25 +109,16 @@ bool brainfuck_readline_util(FILE *stream, char *dest, size_t size,
 #include <io.h>
 #define isatty _isatty
 #define STDIN_FILENO 0
+#define STDOUT_FILENO 1
 #else
+#include <fcntl.h>
 #include <stdio_ext.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
 
-/**
- * @brief Flush the stdin buffer.
- */
-void stdin_flush() {
-#if defined(WIN32) || defined(_WIN32) || \
-    defined(__WIN32) && !defined(__CYGWIN__)
-  fflush(stdin);
-#else
-  __fpurge(stdin);
-  tcflush(STDIN_FILENO, TCIFLUSH);
-#endif
-}
-
 #if defined(__GNUC__)
 #define COMPILER_NAME "GCC"
 #define COMPILER_VERSION __VERSION__
@@ -462,26 +143,228 @@ void stdin_flush() {
 #define OS_NAME "unknown"
 #endif
 
-#define IBF_VERSION_MAJOR 0
-#define IBF_VERSION_MINOR 1
-#define IBF_VERSION_PATCH 0
+/**
+ * @brief The output buffered for the standard output.
+ */
+static uint8_t brainfuck_stdout_buffer[BRAINFUCK_OUTPUT_BUFFER_SIZE];
+
+/**
+ * @brief The number of bytes buffered for the standard output.
+ */
+static size_t brainfuck_stdout_size = 0;
+
+/**
+ * @brief Write the buffered output followed by more bytes straight to the
+ * standard output, in one system call where possible.
+ * @param buffer The bytes to write after the buffered output.
+ * @param length The number of bytes to write after the buffered output.
+ * @return True if everything is written.
+ */
+bool brainfuck_stdout_write(const uint8_t *buffer, size_t length) {
+#if defined(WIN32) || defined(_WIN32) || \
+    defined(__WIN32) && !defined(__CYGWIN__)
+  const uint8_t *parts[2] = {brainfuck_stdout_buffer, buffer};
+  size_t lengths[2] = {brainfuck_stdout_size, length};
+  for (size_t i = 0; i < 2; i += 1) {
+    while (lengths[i] > 0) {
+      int written = _write(STDOUT_FILENO, parts[i],
+                           lengths[i] < INT32_MAX ? (unsigned)lengths[i]
+                                                  : INT32_MAX);
+      if (written < 0) {
+        return false;
+      }
+      parts[i] += written;
+      lengths[i] -= (size_t)written;
+    }
+  }
+#else
+  struct iovec parts[2] = {{brainfuck_stdout_buffer, brainfuck_stdout_size},
+                           {(void *)buffer, length}};
+  struct iovec *part = parts;
+  int count = 2;
+  while (count > 0) {
+    ssize_t written = writev(STDOUT_FILENO, part, count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    /* Skip what is written, which may end in the middle of a part. */
+    while (count > 0 && (size_t)written >= part->iov_len) {
+      written -= (ssize_t)part->iov_len;
+      part += 1;
+      count -= 1;
+    }
+    if (count > 0) {
+      part->iov_base = (uint8_t *)part->iov_base + written;
+      part->iov_len -= (size_t)written;
+    }
+  }
+#endif
+  brainfuck_stdout_size = 0;
+  return true;
+}
+
+/**
+ * @brief Write the buffered output to the standard output.
+ */
+void brainfuck_stdout_flush() {
+  if (brainfuck_stdout_size > 0 && !brainfuck_stdout_write(NULL, 0)) {
+    brainfuck_stdout_size = 0;
+    print_error_write_output();
+    _exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * @brief The input read ahead from the standard input.
+ */
+static uint8_t brainfuck_stdin_buffer[BRAINFUCK_INPUT_BUFFER_SIZE];
 
-uint8_t brainfuck_input_handler_stdin() {
-  char ch = getchar();
-  if (ch == EOF) {
-    // print_error_unexpected_eof();
-    exit(EXIT_FAILURE);
+/**
+ * @brief The unread part of the input, in the read-ahead buffer or in the
+ * mapped standard input.
+ */
+static const uint8_t *brainfuck_stdin_begin = NULL;
+static const uint8_t *brainfuck_stdin_end = NULL;
+
+/**
+ * @brief Whether the standard input is a terminal, -1 until it is known.
+ */
+static int brainfuck_stdin_interactive = -1;
+
+/**
+ * @brief Whether the end of the standard input has been read.
+ */
+static bool brainfuck_stdin_ended = false;
+
+/**
+ * @brief Map the rest of the standard input if it is a regular file, so
+ * that it is read without any copy.
+ * @return True if the standard input is mapped.
+ */
+bool brainfuck_stdin_map() {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  struct stat status;
+  if (fstat(STDIN_FILENO, &status) != 0 || !S_ISREG(status.st_mode)) {
+    return false;
+  }
+  off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+  if (offset < 0 || offset >= status.st_size ||
+      (uint64_t)status.st_size > SIZE_MAX) {
+    return false;
+  }
+  uint8_t *region = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE,
+                         STDIN_FILENO, 0);
+  if (region == MAP_FAILED) {
+    return false;
+  }
+  madvise(region, (size_t)status.st_size, MADV_SEQUENTIAL);
+  /* The mapping lives until exit, and reads past it see the end. */
+  lseek(STDIN_FILENO, 0, SEEK_END);
+  brainfuck_stdin_begin = region + offset;
+  brainfuck_stdin_end = region + status.st_size;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Read ahead as much of the standard input as is available.
+ * @return False at the end of the input.
+ */
+bool brainfuck_stdin_fill() {
+  while (true) {
+#if defined(WIN32) || defined(_WIN32) || \
+    defined(__WIN32) && !defined(__CYGWIN__)
+    int length = _read(STDIN_FILENO, brainfuck_stdin_buffer,
+                       sizeof(brainfuck_stdin_buffer));
+#else
+    ssize_t length = read(STDIN_FILENO, brainfuck_stdin_buffer,
+                          sizeof(brainfuck_stdin_buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (length <= 0) {
+      return false;
+    }
+    brainfuck_stdin_begin = brainfuck_stdin_buffer;
+    brainfuck_stdin_end = brainfuck_stdin_buffer + length;
+    return true;
+  }
+}
+
+/**
+ * @brief Drop the input read ahead, such as what is left of a line typed
+ * into the console.
+ */
+void brainfuck_stdin_discard() {
+  if (brainfuck_stdin_begin >= brainfuck_stdin_buffer &&
+      brainfuck_stdin_begin <
+          brainfuck_stdin_buffer + sizeof(brainfuck_stdin_buffer)) {
+    brainfuck_stdin_begin = brainfuck_stdin_end;
+  }
+}
+
+bool brainfuck_input_handler_stdin(void *user_data, uint8_t *value) {
+  (void)user_data;
+  if (brainfuck_stdin_begin == brainfuck_stdin_end) {
+    if (brainfuck_stdin_interactive < 0) {
+      brainfuck_stdin_interactive = isatty(STDIN_FILENO);
+      if (!brainfuck_stdin_interactive && brainfuck_stdin_map()) {
+        *value = *brainfuck_stdin_begin++;
+        return true;
+      }
+    }
+    if (brainfuck_stdin_interactive) {
+      /* Show what is written so far before waiting for someone to type. */
+      brainfuck_stdout_flush();
+    }
+    if (!brainfuck_stdin_fill()) {
+      brainfuck_stdin_ended = true;
+      return false;
+    }
   }
-  return ch;
+  *value = *brainfuck_stdin_begin++;
+  return true;
 }
 
-void brainfuck_output_handler_stdout(uint8_t c) {
-  if (putchar(c) == EOF) {
-    // print_error_unexpected_eof();
+void brainfuck_output_handler_stdout(void *user_data, const uint8_t *buffer,
+                                     size_t length) {
+  (void)user_data;
+  if (length == 1 && brainfuck_stdout_size < BRAINFUCK_OUTPUT_BUFFER_SIZE) {
+    brainfuck_stdout_buffer[brainfuck_stdout_size++] = *buffer;
+    return;
+  }
+  if (length <= BRAINFUCK_OUTPUT_BUFFER_SIZE - brainfuck_stdout_size) {
+    memcpy(brainfuck_stdout_buffer + brainfuck_stdout_size, buffer, length);
+    brainfuck_stdout_size += length;
+    return;
+  }
+  if (!brainfuck_stdout_write(buffer, length)) {
+    brainfuck_stdout_size = 0;
+    print_error_write_output();
     exit(EXIT_FAILURE);
   }
 }
 
+/**
+ * @brief Flush the stdin buffer.
+ */
+void stdin_flush() {
+#if defined(WIN32) || defined(_WIN32) || \
+    defined(__WIN32) && !defined(__CYGWIN__)
+  fflush(stdin);
+#else
+  __fpurge(stdin);
+  tcflush(STDIN_FILENO, TCIFLUSH);
+#endif
+  brainfuck_stdin_discard();
+}
+
 void console_print_help() {
   fprintf(stderr, "Welcome to IBF %d.%d.%d!\n", IBF_VERSION_MAJOR,
           IBF_VERSION_MINOR, IBF_VERSION_PATCH);
@@ -539,23 +422,96 @@ void console_print_license() {
       "https://www.gnu.org/licenses/gpl-3.0.en.html for more information.\n");
 }
 
-/**
- * @brief Run IBF interactively in the console.
+void console_print_stats(struct brainfuck_context *context) {
+  struct brainfuck_stats stats;
+  brainfuck_context_stats(context, &stats);
+  fprintf(stderr, "Runs: %llu, with %llu loop iterations.\n",
+          (unsigned long long)stats.runs,
+          (unsigned long long)stats.loop_iterations);
+  fprintf(stderr,
+          "Loops: %llu compiled, %llu optimized, nested %zu deep of at most "
+          "%d.\n",
+          (unsigned long long)stats.loops_compiled,
+          (unsigned long long)stats.loops_optimized, stats.max_loop_depth,
+          BRAINFUCK_MAX_LOOP_DEPTH);
+  fprintf(stderr, "Cache: %llu hits, %llu misses.\n",
+          (unsigned long long)stats.cache_hits,
+          (unsigned long long)stats.cache_misses);
+  fprintf(stderr, "Bytes: %llu in, %llu out.\n",
+          (unsigned long long)stats.bytes_in,
+          (unsigned long long)stats.bytes_out);
+  fprintf(stderr, "Tape: %zu cells used of %zu.\n", stats.tape_extent,
+          context->state->memory_limit);
+  fprintf(stderr,
+          "Time: %.3f ms parsing, %.3f ms optimizing, %.3f ms executing.\n",
+          (double)stats.parse_time / 1e6, (double)stats.optimize_time / 1e6,
+          (double)stats.execute_time / 1e6);
+}
+
+/**
+ * @brief Whether a run has spent its budget, which makes IBF exit with
+ * `BRAINFUCK_EXIT_LIMIT`.
+ */
+static bool brainfuck_limit_exceeded = false;
+
+/**
+ * @brief Report a run that failed because it spent its budget.
+ * @param context The context of the run.
+ * @return True if the run spent its budget.
  */
-void run_console() {
+bool brainfuck_report_limit(const struct brainfuck_context *context) {
+  switch (context->state->suspended) {
+    case BRAINFUCK_SUSPEND_STEPS:
+      print_error_step_limit();
+      return true;
+    case BRAINFUCK_SUSPEND_TIMEOUT:
+      print_error_time_limit();
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Get the exit status of IBF after a run.
+ * @param success Whether the run succeeded.
+ * @return The exit status.
+ */
+int brainfuck_exit_status(bool success) {
+  if (success) {
+    return EXIT_SUCCESS;
+  }
+  return brainfuck_limit_exceeded ? BRAINFUCK_EXIT_LIMIT : EXIT_FAILURE;
+}
+
+/**
+ * @brief Run IBF interactively in the console.
+ * @param options The options of IBF.
+ * @return False once it stops, which only happens when the end of the input
+ * stops a program, or when there is no tape to run on.
+ */
+bool run_console(const struct brainfuck_options *options) {
   fprintf(stderr, "IBF %d.%d.%d (tags/v%d.%d.%d, %s, %s) [%s %s] on %s\n",
           IBF_VERSION_MAJOR, IBF_VERSION_MINOR, IBF_VERSION_PATCH,
           IBF_VERSION_MAJOR, IBF_VERSION_MINOR, IBF_VERSION_PATCH, __DATE__,
           __TIME__, COMPILER_NAME, COMPILER_VERSION, OS_NAME);
   fprintf(stderr,
-          "Type \"help\", \"copyright\", \"credits\" or \"license\" for more "
-          "information.\n");
+          "Type \"help\", \"copyright\", \"credits\", \"license\" or \"stats\" "
+          "for more information.\n");
+  fprintf(stderr,
+          "Type \"save\" to keep the tape and \"restore\" to go back to it.\n");
   struct brainfuck_context *context = brainfuck_context_new(
-      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout);
+      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout, NULL,
+      options);
+  if (context == NULL) {
+    print_error_tape_allocation();
+    return false;
+  }
   char *line = calloc(BRAINFUCK_MAX_LINE_LENGTH + 1, sizeof(char));
+  struct brainfuck_snapshot *snapshot = NULL;
   fprintf(stderr, ">>> ");
   while (true) {
-    fflush(stdout);
+    brainfuck_stdout_flush();
     if (!brainfuck_readline_util(stdin, line, BRAINFUCK_MAX_LINE_LENGTH + 1,
                                  '\n')) {
       fprintf(stderr, ">>> ");
@@ -569,78 +525,1408 @@ void run_console() {
       console_print_credits();
     } else if (strcmp(line, "license") == 0) {
       console_print_license();
+    } else if (strcmp(line, "stats") == 0) {
+      console_print_stats(context);
+    } else if (strcmp(line, "save") == 0) {
+      /* One snapshot is kept, a new save replaces it. */
+      struct brainfuck_snapshot *saved = brainfuck_snapshot_save(context);
+      if (saved == NULL) {
+        print_error_snapshot_allocation();
+      } else {
+        brainfuck_snapshot_free(snapshot);
+        snapshot = saved;
+      }
+    } else if (strcmp(line, "restore") == 0) {
+      if (snapshot == NULL) {
+        print_error_no_snapshot();
+      } else if (!brainfuck_snapshot_restore(context, snapshot)) {
+        print_error_tape_allocation();
+      }
     } else {
-      brainfuck_main(context, line);
+      /* Every line gets the whole budget. */
+      brainfuck_context_budget(context, options->max_steps, options->timeout);
+      if (!brainfuck_main(context, line) && !brainfuck_report_limit(context) &&
+          options->eof == BRAINFUCK_EOF_EXIT && brainfuck_stdin_ended) {
+        /* Running out of input stops the console along with the program. */
+        break;
+      }
     }
     stdin_flush();
     fprintf(stderr, ">>> ");
   }
   free(line);
+  brainfuck_snapshot_free(snapshot);
   brainfuck_context_free(context);
+  return false;
 }
 
 /**
- * @brief Run IBF from a file.
- * @param file The file to run.
- * @return True if the file is run successfully.
+ * @brief Map the rest of a file if it is a regular file, so that the
+ * program is compiled straight from the page cache.
+ * @param descriptor The file descriptor to map.
+ * @param length The length of the mapped program.
+ * @return The mapping, or NULL if the file cannot be mapped.
  */
-bool run_file(FILE *file) {
-  struct brainfuck_context *context = brainfuck_context_new(
-      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout);
-  char *line = calloc(BRAINFUCK_MAX_LINE_LENGTH + 1, sizeof(char));
-  while (true) {
-    if (feof(file) || !brainfuck_readline_util(
-                          file, line, BRAINFUCK_MAX_LINE_LENGTH + 1, '\n')) {
+char *brainfuck_source_map(int descriptor, size_t *length) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+    return NULL;
+  }
+  off_t offset = lseek(descriptor, 0, SEEK_CUR);
+  if (offset != 0 || status.st_size == 0 ||
+      (uint64_t)status.st_size > SIZE_MAX) {
+    return NULL;
+  }
+  char *region = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE,
+                      descriptor, 0);
+  if (region == MAP_FAILED) {
+    return NULL;
+  }
+  madvise(region, (size_t)status.st_size, MADV_SEQUENTIAL);
+  /* The program is consumed as if it were read to the end. */
+  lseek(descriptor, 0, SEEK_END);
+  *length = (size_t)status.st_size;
+  return region;
+#else
+  (void)descriptor;
+  (void)length;
+  return NULL;
+#endif
+}
+
+/**
+ * @brief Unmap a program mapped by `brainfuck_source_map`.
+ * @param source The mapping.
+ * @param length The length of the mapping.
+ */
+void brainfuck_source_unmap(char *source, size_t length) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  munmap(source, length);
+#else
+  (void)source;
+  (void)length;
+#endif
+}
+
+/**
+ * @brief Read the rest of a file in large chunks.
+ * @param descriptor The file descriptor to read.
+ * @param length The length of the program read.
+ * @return The program, or NULL if the file cannot be read.
+ */
+char *brainfuck_source_read(int descriptor, size_t *length) {
+  size_t size = 0;
+  size_t capacity = BRAINFUCK_INPUT_BUFFER_SIZE;
+  char *source = malloc(capacity);
+  while (source != NULL) {
+    if (size == capacity) {
+      char *grown = capacity <= SIZE_MAX / 2 ? realloc(source, capacity * 2)
+                                             : NULL;
+      if (grown == NULL) {
+        break;
+      }
+      source = grown;
+      capacity *= 2;
+    }
+#if defined(WIN32) || defined(_WIN32) || \
+    defined(__WIN32) && !defined(__CYGWIN__)
+    size_t chunk = capacity - size > INT32_MAX ? INT32_MAX : capacity - size;
+    int count = _read(descriptor, source + size, (unsigned int)chunk);
+#else
+    ssize_t count = read(descriptor, source + size, capacity - size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (count == 0) {
+      *length = size;
+      return source;
+    }
+    if (count < 0) {
       break;
     }
-    if (!brainfuck_main(context, line)) {
+    size += (size_t)count;
+  }
+  free(source);
+  return NULL;
+}
+
+/**
+ * @brief Get the path of the cached program for a key, under
+ * `$XDG_CACHE_HOME/ibf` or `~/.cache/ibf`, creating the directories.
+ * @param path The buffer for the path.
+ * @param size The size of the buffer.
+ * @param key The hash of the source and of its options.
+ * @return True if there is a cache directory to use.
+ */
+bool brainfuck_cache_path(char *path, size_t size, uint64_t key) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  const char *base = getenv("XDG_CACHE_HOME");
+  const char *suffix = "";
+  /* A relative cache home is ignored, as the specification says. */
+  if (base == NULL || base[0] != '/') {
+    base = getenv("HOME");
+    suffix = "/.cache";
+  }
+  if (base == NULL || base[0] == '\0') {
+    return false;
+  }
+  int length = snprintf(path, size, "%s%s", base, suffix);
+  if (length < 0 || (size_t)length >= size) {
+    return false;
+  }
+  mkdir(path, 0700);
+  length = snprintf(path, size, "%s%s/ibf", base, suffix);
+  if (length < 0 || (size_t)length >= size ||
+      (mkdir(path, 0700) != 0 && errno != EEXIST)) {
+    return false;
+  }
+  length = snprintf(path, size, "%s%s/ibf/%016llx.bfc", base, suffix,
+                    (unsigned long long)key);
+  return length >= 0 && (size_t)length < size;
+#else
+  (void)path;
+  (void)size;
+  (void)key;
+  return false;
+#endif
+}
+
+/**
+ * @brief Map a cached program, if it was compiled for the same key.
+ * @param state The state used to check the program.
+ * @param path The path of the cached program.
+ * @param key The hash of the source and of its options.
+ * @param program Set to the cached instructions on a hit.
+ * @param length Set to the length of the mapping.
+ * @param borrowed Set to true if the instructions are in the mapping.
+ * @return The mapping, or NULL if the cache misses.
+ */
+char *brainfuck_cache_load(struct brainfuck_state *state, const char *path,
+                           uint64_t key, struct brainfuck_program *program,
+                           size_t *length, bool *borrowed) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return NULL;
+  }
+  char *mapping = brainfuck_source_map(descriptor, length);
+  close(descriptor);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  struct brainfuck_program_header header;
+  struct brainfuck_program cached;
+  if (!brainfuck_program_read(mapping, *length, &header, &cached, borrowed)) {
+    brainfuck_source_unmap(mapping, *length);
+    return NULL;
+  }
+  if (header.key != key || !brainfuck_program_validate(state, &cached)) {
+    if (!*borrowed) {
+      free(cached.instructions);
+    }
+    brainfuck_source_unmap(mapping, *length);
+    return NULL;
+  }
+  free(program->instructions);
+  free(program->sources);
+  *program = cached;
+  return mapping;
+#else
+  (void)state;
+  (void)path;
+  (void)key;
+  (void)program;
+  (void)length;
+  (void)borrowed;
+  return NULL;
+#endif
+}
+
+/**
+ * @brief Store a compiled program in the cache. It is written aside and
+ * renamed into place, so that a concurrent run never maps half of it.
+ * Failing to store it only costs the next run a compilation.
+ * @param path The path of the cached program.
+ * @param program The program to store.
+ * @param header What the program was compiled from and for.
+ */
+void brainfuck_cache_store(const char *path,
+                           const struct brainfuck_program *program,
+                           const struct brainfuck_program_header *header) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  char temporary[BRAINFUCK_MAX_PATH_LENGTH];
+  int length = snprintf(temporary, sizeof(temporary), "%s.%ld", path,
+                        (long)getpid());
+  if (length < 0 || (size_t)length >= sizeof(temporary)) {
+    return;
+  }
+  FILE *stream = fopen(temporary, "wb");
+  if (stream == NULL) {
+    return;
+  }
+  bool success = brainfuck_program_write(stream, program, header);
+  success = fclose(stream) == 0 && success;
+  if (!success || rename(temporary, path) != 0) {
+    remove(temporary);
+  }
+#else
+  (void)path;
+  (void)program;
+  (void)header;
+#endif
+}
+
+/**
+ * @brief Execute a compiled program, or write its translation to the output
+ * file of the options or to the standard output.
+ * @param context The context of IBF.
+ * @param program The program to run.
+ * @param header What the program was compiled from and for.
+ * @return True if the program is run successfully.
+ */
+bool brainfuck_run_program(struct brainfuck_context *context,
+                           const struct brainfuck_program *program,
+                           const struct brainfuck_program_header *header) {
+  const struct brainfuck_options *options = &context->options;
+  if (options->emit == BRAINFUCK_EMIT_NONE) {
+    bool success = brainfuck_program_execute(context, program);
+    if (!success && brainfuck_report_limit(context)) {
+      brainfuck_limit_exceeded = true;
+    }
+    if (context->profile != NULL) {
+      /* Keep the output of the program ahead of the profile. */
+      brainfuck_stdout_flush();
+      brainfuck_profile_report(stderr, context->profile, program);
+    }
+    return success;
+  }
+  if (options->emit != BRAINFUCK_EMIT_BYTECODE &&
+      context->state->tape != BRAINFUCK_TAPE_FIXED) {
+    print_error_emit_tape();
+    return false;
+  }
+  FILE *stream = stdout;
+  if (options->output != NULL) {
+    stream = fopen(options->output,
+                   options->emit == BRAINFUCK_EMIT_BYTECODE ? "wb" : "w");
+    if (stream == NULL) {
+      print_error_write_output();
       return false;
     }
   }
-  free(line);
-  if (context->state->loop_size > 0) {
+  bool success = true;
+  if (options->emit == BRAINFUCK_EMIT_C) {
+    brainfuck_emit_c(stream, program, context->state->memory_size,
+                     options->eof);
+  } else if (options->emit == BRAINFUCK_EMIT_ASM) {
+    brainfuck_emit_asm(stream, program, context->state->memory_size,
+                       options->eof);
+  } else {
+    success = brainfuck_program_write(stream, program, header);
+  }
+  success = fflush(stream) == 0 && success;
+  if (stream != stdout) {
+    success = fclose(stream) == 0 && success;
+  }
+  if (!success) {
+    print_error_write_output();
+  }
+  return success;
+}
+
+/**
+ * @brief Print the statistics of a context after a run, if the options ask
+ * for them.
+ * @param context The context of the run.
+ */
+void brainfuck_report_stats(struct brainfuck_context *context) {
+  if (context->options.stats) {
+    /* Keep the output of the program ahead of the statistics. */
+    brainfuck_stdout_flush();
+    console_print_stats(context);
+  }
+}
+
+/**
+ * @brief Fill in what a program compiled from source is compiled for, and
+ * the key it is cached under.
+ * @param header The header to fill in.
+ * @param src The brainfuck code.
+ * @param length The length of the brainfuck code.
+ * @param options The options of IBF.
+ * @param memory_limit The cells the tape of a context can hold.
+ */
+void brainfuck_program_key(struct brainfuck_program_header *header,
+                           const char *src, size_t length,
+                           const struct brainfuck_options *options,
+                           size_t memory_limit) {
+  /* The optimized program depends on the level, on the tape it wraps and on
+   * how much of its start is folded. */
+  header->memory_size = memory_limit;
+  header->tape = options->tape;
+  header->optimization_level = options->optimization_level;
+  uint64_t parameters[] = {BRAINFUCK_PROGRAM_VERSION,
+                           header->optimization_level, header->tape,
+                           header->memory_size, options->fold_steps};
+  header->key = brainfuck_hash(
+      src, length, brainfuck_hash(parameters, sizeof(parameters), 0));
+}
+
+/**
+ * @brief Compile a whole brainfuck program, then execute it or write its
+ * translation.
+ * @param src The brainfuck code to run.
+ * @param length The length of the brainfuck code.
+ * @param options The options of IBF.
+ * @return True if the program is run successfully.
+ */
+bool brainfuck_run_source(const char *src, size_t length,
+                          const struct brainfuck_options *options) {
+  struct brainfuck_context *context = brainfuck_context_new(
+      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout, NULL,
+      options);
+  if (context == NULL) {
+    print_error_tape_allocation();
+    return false;
+  }
+  struct brainfuck_program *program = brainfuck_program_new();
+  if (program == NULL) {
+    print_error_program_allocation();
     brainfuck_context_free(context);
-    print_error_unmatched_loop_start();
     return false;
   }
+  struct brainfuck_program_header header;
+  brainfuck_program_key(&header, src, length, options,
+                        context->state->memory_limit);
+  /* A profile points at the source, which a cached program does not keep. */
+  bool profiled = options->engine == BRAINFUCK_ENGINE_PROFILE;
+  if (profiled && !brainfuck_program_track(program)) {
+    brainfuck_program_free(program);
+    brainfuck_context_free(context);
+    return false;
+  }
+  char path[BRAINFUCK_MAX_PATH_LENGTH];
+  bool cached = options->cache && !profiled &&
+                brainfuck_cache_path(path, sizeof(path), header.key);
+  size_t mapping_length = 0;
+  bool borrowed = false;
+  char *mapping =
+      cached ? brainfuck_cache_load(context->state, path, header.key, program,
+                                     &mapping_length, &borrowed)
+             : NULL;
+  if (cached) {
+    if (mapping != NULL) {
+      context->state->stats.cache_hits += 1;
+    } else {
+      context->state->stats.cache_misses += 1;
+    }
+  }
+  if (mapping == NULL) {
+    if (!brainfuck_compile(context->state, program, src, length) ||
+        !brainfuck_optimize(context->state, program,
+                            options->optimization_level) ||
+        !brainfuck_program_fold(program, options)) {
+      brainfuck_program_free(program);
+      brainfuck_context_free(context);
+      return false;
+    }
+    if (cached) {
+      brainfuck_cache_store(path, program, &header);
+    }
+  }
+  bool success = brainfuck_run_program(context, program, &header);
+  brainfuck_report_stats(context);
+  if (mapping != NULL) {
+    if (borrowed) {
+      /* The mapped instructions are not owned by the program. */
+      program->instructions = NULL;
+    }
+    brainfuck_source_unmap(mapping, mapping_length);
+  }
   brainfuck_context_free(context);
-  return true;
+  brainfuck_program_free(program);
+  return success;
+}
+
+/**
+ * @brief Run a compiled program file on the tape it was compiled for,
+ * without parsing or optimizing anything.
+ * @param bytes The bytes of the file.
+ * @param length The number of bytes.
+ * @param options The options of IBF, whose tape is replaced.
+ * @return True if the program is run successfully.
+ */
+bool brainfuck_run_compiled(const char *bytes, size_t length,
+                            const struct brainfuck_options *options) {
+  struct brainfuck_program_header header;
+  struct brainfuck_program program;
+  bool borrowed = false;
+  if (!brainfuck_program_read(bytes, length, &header, &program, &borrowed)) {
+    print_error_compiled_program();
+    return false;
+  }
+  struct brainfuck_options compiled = *options;
+  compiled.tape = header.tape;
+  compiled.tape_size = header.memory_size;
+  struct brainfuck_context *context = brainfuck_context_new(
+      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout, NULL,
+      &compiled);
+  bool success = context != NULL;
+  if (!success) {
+    print_error_tape_allocation();
+  } else if (!brainfuck_program_validate(context->state, &program)) {
+    print_error_compiled_program();
+    success = false;
+  } else {
+    success = brainfuck_run_program(context, &program, &header);
+    brainfuck_report_stats(context);
+  }
+  if (!borrowed) {
+    free(program.instructions);
+  }
+  brainfuck_context_free(context);
+  return success;
+}
+
+/**
+ * @brief Run IBF from a file, loaded in one go and compiled as a whole, or
+ * run it straight away if it is a compiled program.
+ * @param file The file to run.
+ * @param options The options of IBF.
+ * @return True if the file is run successfully.
+ */
+bool run_file(FILE *file, const struct brainfuck_options *options) {
+  int descriptor = fileno(file);
+  size_t length = 0;
+  char *source = brainfuck_source_map(descriptor, &length);
+  bool mapped = source != NULL;
+  if (!mapped) {
+    source = brainfuck_source_read(descriptor, &length);
+  }
+  if (source == NULL) {
+    print_error_read_source();
+    return false;
+  }
+  bool success = brainfuck_program_detect(source, length)
+                     ? brainfuck_run_compiled(source, length, options)
+                     : brainfuck_run_source(source, length, options);
+  if (mapped) {
+    brainfuck_source_unmap(source, length);
+  } else {
+    free(source);
+  }
+  return success;
 }
 
 /**
  * @brief Run IBF from a command.
  * @param command The command to run.
+ * @param options The options of IBF.
  * @return True if the command is run successfully.
  */
-bool run_command(char *command) {
-  int32_t unmatched_loop = 0;
-  for (size_t i = 0; command[i] != '\0'; i++) {
-    switch (command[i]) {
-      case '[':
-        unmatched_loop += 1;
-        break;
-      case ']':
-        unmatched_loop -= 1;
-        break;
-      default:
-        break;
+bool run_command(char *command, const struct brainfuck_options *options) {
+  /* The command is checked as it is compiled, before any of it runs. */
+  return brainfuck_run_source(command, strlen(command), options);
+}
+
+/**
+ * @brief Check that a compiled program can run on a state, which it only
+ * can on the tape it was compiled for.
+ * @param state The state of IBF.
+ * @param header The header of the compiled program.
+ * @param program The compiled program.
+ * @return True if the program runs on the tape of the state.
+ */
+bool brainfuck_compiled_compatible(
+    struct brainfuck_state *state,
+    const struct brainfuck_program_header *header,
+    const struct brainfuck_program *program) {
+  return header->tape == state->tape &&
+         header->memory_size == state->memory_limit &&
+         brainfuck_program_validate(state, program);
+}
+
+/**
+ * @brief A program of a batch, compiled once and shared read-only by every
+ * job that runs it.
+ */
+struct brainfuck_batch_program {
+  const char *path;                  /* The program file. */
+  struct brainfuck_program *program; /* The program, NULL if it failed. */
+  struct brainfuck_program_header header; /* What a compiled file is for. */
+  bool compiled; /* Whether the file is a compiled program. */
+  char *bytes;   /* The file, while the instructions are borrowed from it. */
+  size_t length; /* The length of the file. */
+  bool mapped;   /* Whether the file is mapped. */
+};
+
+/**
+ * @brief A job of a batch, which runs a program on its own input and
+ * collects its own output.
+ */
+struct brainfuck_batch_job {
+  const char *path;       /* The program file. */
+  const char *input_path; /* The input file, NULL for no input. */
+  struct brainfuck_batch_program *program; /* The program to run. */
+  const uint8_t *input;     /* The unread input. */
+  const uint8_t *input_end; /* The end of the input. */
+  uint8_t *output;          /* The output collected so far. */
+  size_t output_size;       /* The number of bytes collected. */
+  size_t output_capacity;   /* The number of bytes allocated. */
+  bool output_lost;         /* Whether some output could not be kept. */
+  bool limited;             /* Whether the job spent its budget. */
+  bool success;             /* Whether the job ran successfully. */
+  bool done;                /* Whether the job is finished. */
+};
+
+struct brainfuck_batch;
+
+/**
+ * @brief A worker of a batch. It takes tasks from the front of its own
+ * range, and once that is empty it steals from the back of the others.
+ */
+struct brainfuck_batch_worker {
+  struct brainfuck_batch *batch; /* The batch being run. */
+  struct brainfuck_pool *pool;   /* The contexts of this worker. */
+  size_t begin;                  /* The first task left. */
+  size_t end;                    /* The end of the tasks left. */
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_mutex_t lock; /* Guards the tasks left. */
+  pthread_t thread;     /* The thread of the worker. */
+  bool started;         /* Whether the thread is running. */
+#endif
+};
+
+/**
+ * @brief A batch of jobs run in parallel, whose outputs are written in the
+ * order of the manifest.
+ */
+struct brainfuck_batch {
+  const struct brainfuck_options *options;  /* The options of every job. */
+  struct brainfuck_batch_job *jobs;         /* The jobs. */
+  size_t job_count;                         /* The number of jobs. */
+  struct brainfuck_batch_program *programs; /* The distinct programs. */
+  size_t program_count;                     /* The number of programs. */
+  struct brainfuck_batch_worker *workers;   /* The workers. */
+  size_t worker_count;                      /* The number of workers. */
+  /* The task the workers run, on the index of a program or a job. */
+  void (*task)(struct brainfuck_batch_worker *worker, size_t index);
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_mutex_t lock; /* Guards whether jobs are done. */
+  pthread_cond_t done;  /* Signaled whenever a job is done. */
+#endif
+};
+
+/**
+ * @brief Map or read a whole file.
+ * @param path The path of the file.
+ * @param length Set to the length of the file.
+ * @param mapped Set to true if the file is mapped rather than read.
+ * @return The bytes of the file, or NULL if it cannot be read.
+ */
+char *brainfuck_batch_load(const char *path, size_t *length, bool *mapped) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  char *bytes = brainfuck_source_map(fileno(file), length);
+  *mapped = bytes != NULL;
+  if (!*mapped) {
+    bytes = brainfuck_source_read(fileno(file), length);
+  }
+  fclose(file);
+  return bytes;
+}
+
+/**
+ * @brief Release a file loaded by `brainfuck_batch_load`.
+ * @param bytes The bytes of the file.
+ * @param length The length of the file.
+ * @param mapped Whether the file is mapped.
+ */
+void brainfuck_batch_unload(char *bytes, size_t length, bool mapped) {
+  if (mapped) {
+    brainfuck_source_unmap(bytes, length);
+  } else {
+    free(bytes);
+  }
+}
+
+bool brainfuck_input_handler_batch(void *user_data, uint8_t *value) {
+  struct brainfuck_batch_job *job = user_data;
+  if (job->input == job->input_end) {
+    return false;
+  }
+  *value = *job->input++;
+  return true;
+}
+
+void brainfuck_output_handler_batch(void *user_data, const uint8_t *buffer,
+                                    size_t length) {
+  struct brainfuck_batch_job *job = user_data;
+  if (length > job->output_capacity - job->output_size) {
+    size_t capacity = job->output_capacity == 0 ? BRAINFUCK_OUTPUT_BUFFER_SIZE
+                                                : job->output_capacity;
+    while (capacity - job->output_size < length && capacity <= SIZE_MAX / 2) {
+      capacity *= 2;
+    }
+    uint8_t *grown = capacity - job->output_size >= length
+                         ? realloc(job->output, capacity)
+                         : NULL;
+    if (grown == NULL) {
+      job->output_lost = true;
+      return;
+    }
+    job->output = grown;
+    job->output_capacity = capacity;
+  }
+  memcpy(job->output + job->output_size, buffer, length);
+  job->output_size += length;
+}
+
+/**
+ * @brief Compile a program of a batch, or load it if it is compiled.
+ * @param worker The worker compiling it.
+ * @param index The index of the program.
+ */
+void brainfuck_batch_compile(struct brainfuck_batch_worker *worker,
+                             size_t index) {
+  struct brainfuck_batch_program *program = &worker->batch->programs[index];
+  size_t length = 0;
+  bool mapped = false;
+  char *bytes = brainfuck_batch_load(program->path, &length, &mapped);
+  if (bytes == NULL) {
+    print_error_read_source();
+    return;
+  }
+  program->compiled = brainfuck_program_detect(bytes, length);
+  if (!program->compiled) {
+    program->program =
+        brainfuck_program_compile(bytes, length, worker->batch->options);
+    brainfuck_batch_unload(bytes, length, mapped);
+    return;
+  }
+  struct brainfuck_program loaded;
+  bool borrowed = false;
+  if (!brainfuck_program_read(bytes, length, &program->header, &loaded,
+                              &borrowed)) {
+    print_error_compiled_program();
+    brainfuck_batch_unload(bytes, length, mapped);
+    return;
+  }
+  program->program = brainfuck_program_new();
+  if (program->program == NULL) {
+    print_error_program_allocation();
+    if (!borrowed) {
+      free(loaded.instructions);
+    }
+    brainfuck_batch_unload(bytes, length, mapped);
+    return;
+  }
+  *program->program = loaded;
+  if (!borrowed) {
+    brainfuck_batch_unload(bytes, length, mapped);
+    return;
+  }
+  /* The instructions are used in place until the batch is over. */
+  program->bytes = bytes;
+  program->length = length;
+  program->mapped = mapped;
+}
+
+/**
+ * @brief Run a job of a batch on a context of the worker.
+ * @param worker The worker running it.
+ * @param index The index of the job.
+ */
+void brainfuck_batch_execute(struct brainfuck_batch_worker *worker,
+                             size_t index) {
+  struct brainfuck_batch *batch = worker->batch;
+  struct brainfuck_batch_job *job = &batch->jobs[index];
+  const struct brainfuck_batch_program *program = job->program;
+  char *input = NULL;
+  size_t input_length = 0;
+  bool input_mapped = false;
+  bool success = program->program != NULL;
+  if (success && job->input_path != NULL) {
+    input = brainfuck_batch_load(job->input_path, &input_length,
+                                 &input_mapped);
+    if (input == NULL) {
+      print_error_read_input();
+      success = false;
     }
+    job->input = (const uint8_t *)input;
+    job->input_end = job->input + input_length;
   }
-  if (unmatched_loop < 0) {
-    print_error_unmatched_loop_end();
+  struct brainfuck_context *context =
+      success ? brainfuck_pool_acquire(worker->pool,
+                                       brainfuck_input_handler_batch,
+                                       brainfuck_output_handler_batch, job)
+              : NULL;
+  if (success && context == NULL) {
+    print_error_tape_allocation();
+    success = false;
+  }
+  if (success && program->compiled &&
+      !brainfuck_compiled_compatible(context->state, &program->header,
+                                     program->program)) {
+    print_error_compiled_program();
+    success = false;
+  }
+  if (success) {
+    success = brainfuck_program_execute(context, program->program);
+    job->limited = !success && brainfuck_report_limit(context);
+  }
+  if (context != NULL) {
+    brainfuck_pool_release(worker->pool, context);
+  }
+  if (input != NULL) {
+    brainfuck_batch_unload(input, input_length, input_mapped);
+  }
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_mutex_lock(&batch->lock);
+#endif
+  job->success = success && !job->output_lost;
+  job->done = true;
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_cond_signal(&batch->done);
+  pthread_mutex_unlock(&batch->lock);
+#endif
+}
+
+/**
+ * @brief Take the next task of a worker, from its own range or else from
+ * the back of the range of another worker.
+ * @param worker The worker.
+ * @param index Set to the index of the task.
+ * @return False once no worker has any task left.
+ */
+bool brainfuck_batch_take(struct brainfuck_batch_worker *worker,
+                          size_t *index) {
+  struct brainfuck_batch *batch = worker->batch;
+  size_t self = (size_t)(worker - batch->workers);
+  for (size_t i = 0; i < batch->worker_count; i += 1) {
+    struct brainfuck_batch_worker *victim =
+        &batch->workers[(self + i) % batch->worker_count];
+    bool taken = false;
+#if defined(BRAINFUCK_HAVE_THREADS)
+    pthread_mutex_lock(&victim->lock);
+#endif
+    if (victim->begin < victim->end) {
+      /* The owner works forwards and thieves backwards, so they meet last. */
+      *index = victim == worker ? victim->begin++ : --victim->end;
+      taken = true;
+    }
+#if defined(BRAINFUCK_HAVE_THREADS)
+    pthread_mutex_unlock(&victim->lock);
+#endif
+    if (taken) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Run the tasks of a worker, and steal more until none are left.
+ * @param argument The worker.
+ * @return NULL.
+ */
+void *brainfuck_batch_work(void *argument) {
+  struct brainfuck_batch_worker *worker = argument;
+  size_t index = 0;
+  while (brainfuck_batch_take(worker, &index)) {
+    worker->batch->task(worker, index);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Split tasks among the workers of a batch and start them. Without
+ * threads, or if none can be started, the tasks are run right away.
+ * @param batch The batch.
+ * @param count The number of tasks.
+ * @param task The task to run on each index.
+ */
+void brainfuck_batch_start(struct brainfuck_batch *batch, size_t count,
+                           void (*task)(struct brainfuck_batch_worker *worker,
+                                        size_t index)) {
+  batch->task = task;
+  for (size_t i = 0; i < batch->worker_count; i += 1) {
+    batch->workers[i].begin = count * i / batch->worker_count;
+    batch->workers[i].end = count * (i + 1) / batch->worker_count;
+  }
+  size_t started = 0;
+#if defined(BRAINFUCK_HAVE_THREADS)
+  for (size_t i = 0; i < batch->worker_count; i += 1) {
+    struct brainfuck_batch_worker *worker = &batch->workers[i];
+    /* The tasks of a worker that does not start are stolen by the others. */
+    worker->started = pthread_create(&worker->thread, NULL,
+                                     brainfuck_batch_work, worker) == 0;
+    started += worker->started;
+  }
+#endif
+  if (started == 0) {
+    brainfuck_batch_work(&batch->workers[0]);
+  }
+}
+
+/**
+ * @brief Wait for the workers of a batch to run out of tasks.
+ * @param batch The batch.
+ */
+void brainfuck_batch_join(struct brainfuck_batch *batch) {
+#if defined(BRAINFUCK_HAVE_THREADS)
+  for (size_t i = 0; i < batch->worker_count; i += 1) {
+    if (batch->workers[i].started) {
+      pthread_join(batch->workers[i].thread, NULL);
+      batch->workers[i].started = false;
+    }
+  }
+#else
+  (void)batch;
+#endif
+}
+
+/**
+ * @brief Order jobs by their program file.
+ * @param a A job.
+ * @param b Another job.
+ * @return The order of the program files.
+ */
+int brainfuck_batch_compare(const void *a, const void *b) {
+  const struct brainfuck_batch_job *const *job_a = a;
+  const struct brainfuck_batch_job *const *job_b = b;
+  return strcmp((*job_a)->path, (*job_b)->path);
+}
+
+/**
+ * @brief Read the jobs of a manifest, one per line: the program file, then
+ * optionally the input file after spaces or tabs. Blank lines are skipped.
+ * @param batch The batch to fill.
+ * @param text The manifest, which is split in place.
+ * @param length The length of the manifest.
+ * @return True if the jobs and their programs are allocated.
+ */
+bool brainfuck_batch_parse(struct brainfuck_batch *batch, char *text,
+                           size_t length) {
+  size_t lines = 1;
+  for (size_t i = 0; i < length; i += 1) {
+    lines += text[i] == '\n';
+  }
+  batch->jobs = calloc(lines, sizeof(struct brainfuck_batch_job));
+  batch->programs = calloc(lines, sizeof(struct brainfuck_batch_program));
+  struct brainfuck_batch_job **sorted =
+      calloc(lines, sizeof(struct brainfuck_batch_job *));
+  if (batch->jobs == NULL || batch->programs == NULL || sorted == NULL) {
+    free(sorted);
     return false;
-  } else if (unmatched_loop > 0) {
-    print_error_unmatched_loop_start();
+  }
+  char *line = text;
+  char *end = text + length;
+  while (line < end) {
+    char *next = memchr(line, '\n', (size_t)(end - line));
+    next = next == NULL ? end : next;
+    *next = '\0';
+    char *fields[2] = {NULL, NULL};
+    size_t count = 0;
+    for (char *p = line; p < next; p += 1) {
+      if (isspace((unsigned char)*p)) {
+        *p = '\0';
+      } else if (p == line || p[-1] == '\0') {
+        if (count == 2) {
+          break;
+        }
+        fields[count++] = p;
+      }
+    }
+    if (fields[0] != NULL) {
+      struct brainfuck_batch_job *job = &batch->jobs[batch->job_count];
+      job->path = fields[0];
+      job->input_path = fields[1];
+      sorted[batch->job_count] = job;
+      batch->job_count += 1;
+    }
+    line = next + 1;
+  }
+  /* Each program file is compiled once, whatever the number of its jobs. */
+  qsort(sorted, batch->job_count, sizeof(struct brainfuck_batch_job *),
+        brainfuck_batch_compare);
+  for (size_t i = 0; i < batch->job_count; i += 1) {
+    if (i == 0 || strcmp(sorted[i]->path, sorted[i - 1]->path) != 0) {
+      batch->programs[batch->program_count].path = sorted[i]->path;
+      batch->program_count += 1;
+    }
+    sorted[i]->program = &batch->programs[batch->program_count - 1];
+  }
+  free(sorted);
+  return true;
+}
+
+/**
+ * @brief Run every program of a manifest in parallel, each job on its own
+ * tape with its own input, and write their outputs in the order of the
+ * manifest.
+ * @param path The path of the manifest.
+ * @param jobs The number of threads, 0 for one per processor.
+ * @param options The options of IBF.
+ * @return True if every job is run successfully.
+ */
+bool run_batch(const char *path, size_t jobs,
+               const struct brainfuck_options *options) {
+  size_t length = 0;
+  bool mapped = false;
+  char *bytes = brainfuck_batch_load(path, &length, &mapped);
+  /* The manifest is split in place, so it needs a copy of its own. */
+  char *text = bytes == NULL ? NULL : malloc(length + 1);
+  if (text != NULL) {
+    memcpy(text, bytes, length);
+  }
+  if (bytes != NULL) {
+    brainfuck_batch_unload(bytes, length, mapped);
+  }
+  if (text == NULL) {
+    print_error_read_source();
     return false;
   }
-  struct brainfuck_context *context = brainfuck_context_new(
-      brainfuck_input_handler_stdin, brainfuck_output_handler_stdout);
-  if (!brainfuck_main(context, command)) {
-    brainfuck_context_free(context);
+  struct brainfuck_batch batch;
+  memset(&batch, 0, sizeof(batch));
+  batch.options = options;
+  if (jobs == 0) {
+#if defined(BRAINFUCK_HAVE_THREADS)
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = processors > 0 ? (size_t)processors : 1;
+#else
+    jobs = 1;
+#endif
+  }
+  bool success = brainfuck_batch_parse(&batch, text, length);
+  batch.worker_count = jobs < batch.job_count ? jobs : batch.job_count;
+  batch.worker_count = batch.worker_count == 0 ? 1 : batch.worker_count;
+  batch.workers = success ? calloc(batch.worker_count,
+                                   sizeof(struct brainfuck_batch_worker))
+                          : NULL;
+  for (size_t i = 0; batch.workers != NULL && i < batch.worker_count; i += 1) {
+    batch.workers[i].batch = &batch;
+    /* A worker runs one job at a time, so one idle context is enough. */
+    batch.workers[i].pool = brainfuck_pool_new(options, 1);
+    success = success && batch.workers[i].pool != NULL;
+#if defined(BRAINFUCK_HAVE_THREADS)
+    pthread_mutex_init(&batch.workers[i].lock, NULL);
+#endif
+  }
+  if (batch.workers == NULL || !success) {
+    print_error_tape_allocation();
+    success = false;
+  }
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.done, NULL);
+#endif
+  if (success) {
+    brainfuck_batch_start(&batch, batch.program_count,
+                          brainfuck_batch_compile);
+    brainfuck_batch_join(&batch);
+    brainfuck_batch_start(&batch, batch.job_count, brainfuck_batch_execute);
+    /* Write each output as soon as the jobs before it are written. */
+    for (size_t i = 0; i < batch.job_count; i += 1) {
+      struct brainfuck_batch_job *job = &batch.jobs[i];
+#if defined(BRAINFUCK_HAVE_THREADS)
+      pthread_mutex_lock(&batch.lock);
+      while (!job->done) {
+        pthread_cond_wait(&batch.done, &batch.lock);
+      }
+      pthread_mutex_unlock(&batch.lock);
+#endif
+      if (job->output_size > 0) {
+        brainfuck_output_handler_stdout(NULL, job->output, job->output_size);
+      }
+      if (job->output_lost) {
+        print_error_write_output();
+      }
+      free(job->output);
+      job->output = NULL;
+      success = success && job->success;
+      brainfuck_limit_exceeded = brainfuck_limit_exceeded || job->limited;
+    }
+    brainfuck_batch_join(&batch);
+  }
+  for (size_t i = 0; i < batch.program_count; i += 1) {
+    struct brainfuck_batch_program *program = &batch.programs[i];
+    if (program->bytes != NULL) {
+      /* The borrowed instructions are not owned by the program. */
+      program->program->instructions = NULL;
+      brainfuck_batch_unload(program->bytes, program->length,
+                             program->mapped);
+    }
+    if (program->program != NULL) {
+      brainfuck_program_free(program->program);
+    }
+  }
+  for (size_t i = 0; batch.workers != NULL && i < batch.worker_count; i += 1) {
+    brainfuck_pool_free(batch.workers[i].pool);
+#if defined(BRAINFUCK_HAVE_THREADS)
+    pthread_mutex_destroy(&batch.workers[i].lock);
+#endif
+  }
+#if defined(BRAINFUCK_HAVE_THREADS)
+  pthread_mutex_destroy(&batch.lock);
+  pthread_cond_destroy(&batch.done);
+#endif
+  free(batch.workers);
+  free(batch.programs);
+  free(batch.jobs);
+  free(text);
+  return success;
+}
+
+/**
+ * @brief A worker that runs jobs sent over the standard input, and answers
+ * on the standard output, for as long as the input lasts. Its programs and
+ * contexts stay loaded from one job to the next.
+ *
+ * Every message, either way, is a 32-bit length followed by that many
+ * bytes, the first of which is the kind of the message. All integers are
+ * little-endian.
+ *
+ * - `P` and a program, its source or a compiled program file, loads it. It
+ *   is answered with `P` and the 64-bit key of the program.
+ * - `J`, the 64-bit key of a program, the 64-bit loop iterations and
+ *   milliseconds of its budget, 0 for those of the options, and then its
+ *   input runs a job. It is answered with `J`, the exit status of the run
+ *   as IBF would exit with it, the 64-bit loop iterations, bytes read,
+ *   bytes written and nanoseconds of the run, and then its output.
+ *
+ * A message that cannot be served is answered with `E` and the reason.
+ */
+struct brainfuck_worker {
+  const struct brainfuck_options *options;  /* The options of every job. */
+  struct brainfuck_pool *pool;              /* The contexts of the jobs. */
+  struct brainfuck_batch_program *programs; /* The programs loaded. */
+  size_t program_count;                     /* The number of programs. */
+  size_t program_capacity;                  /* The allocated programs. */
+};
+
+/**
+ * @brief Answer a message.
+ * @param kind The kind of the answer.
+ * @param head The fields of the answer.
+ * @param head_length The length of the fields.
+ * @param body The bytes after the fields.
+ * @param body_length The length of the bytes after the fields.
+ * @return True if the answer is written.
+ */
+bool brainfuck_worker_reply(uint8_t kind, const uint8_t *head,
+                            size_t head_length, const uint8_t *body,
+                            size_t body_length) {
+  if (body_length > UINT32_MAX - 1 - head_length) {
     return false;
   }
-  brainfuck_context_free(context);
-  return true;
+  uint8_t frame[5];
+  brainfuck_store_le(frame, 1 + head_length + body_length, 4);
+  frame[4] = kind;
+  /* The length and the fields are buffered, so that the whole answer is
+   * written at once. */
+  brainfuck_output_handler_stdout(NULL, frame, sizeof(frame));
+  if (head_length > 0) {
+    brainfuck_output_handler_stdout(NULL, head, head_length);
+  }
+  return brainfuck_stdout_write(body, body_length);
+}
+
+/**
+ * @brief Answer a message that cannot be served.
+ * @param reason The reason.
+ * @return True if the answer is written.
+ */
+bool brainfuck_worker_error(const char *reason) {
+  return brainfuck_worker_reply('E', NULL, 0, (const uint8_t *)reason,
+                                strlen(reason));
+}
+
+/**
+ * @brief Make room for one more program of a worker.
+ * @param worker The worker.
+ * @return The cleared room for the program, or NULL if it cannot be
+ * allocated.
+ */
+struct brainfuck_batch_program *brainfuck_worker_add(
+    struct brainfuck_worker *worker) {
+  if (worker->program_count == worker->program_capacity) {
+    size_t capacity =
+        worker->program_capacity == 0 ? 16 : worker->program_capacity * 2;
+    struct brainfuck_batch_program *programs = realloc(
+        worker->programs, sizeof(struct brainfuck_batch_program) * capacity);
+    if (programs == NULL) {
+      return NULL;
+    }
+    worker->programs = programs;
+    worker->program_capacity = capacity;
+  }
+  struct brainfuck_batch_program *program =
+      &worker->programs[worker->program_count];
+  memset(program, 0, sizeof(struct brainfuck_batch_program));
+  return program;
+}
+
+/**
+ * @brief Find a program of a worker by its key, or load it from the cache
+ * if the options allow it.
+ * @param worker The worker.
+ * @param key The key of the program.
+ * @param state The state used to check a cached program.
+ * @return The program, or NULL if it is not loaded.
+ */
+struct brainfuck_batch_program *brainfuck_worker_find(
+    struct brainfuck_worker *worker, uint64_t key,
+    struct brainfuck_state *state) {
+  for (size_t i = 0; i < worker->program_count; i += 1) {
+    if (worker->programs[i].header.key == key) {
+      return &worker->programs[i];
+    }
+  }
+  char path[BRAINFUCK_MAX_PATH_LENGTH];
+  struct brainfuck_batch_program *program = NULL;
+  if (!worker->options->cache ||
+      !brainfuck_cache_path(path, sizeof(path), key) ||
+      (program = brainfuck_worker_add(worker)) == NULL) {
+    return NULL;
+  }
+  program->program = brainfuck_program_new();
+  if (program->program == NULL) {
+    return NULL;
+  }
+  bool borrowed = false;
+  program->bytes = brainfuck_cache_load(state, path, key, program->program,
+                                        &program->length, &borrowed);
+  if (program->bytes == NULL) {
+    brainfuck_program_free(program->program);
+    return NULL;
+  }
+  if (!borrowed) {
+    brainfuck_source_unmap(program->bytes, program->length);
+    program->bytes = NULL;
+  }
+  /* The cached program was compiled from source with the same options. */
+  program->header.key = key;
+  program->mapped = true;
+  worker->program_count += 1;
+  return program;
+}
+
+/**
+ * @brief Load a program sent to a worker, unless it is loaded already.
+ * @param worker The worker.
+ * @param state The state used to compile and check the program.
+ * @param bytes The program, which the worker takes.
+ * @param length The length of the program.
+ * @return True if the answer is written.
+ */
+bool brainfuck_worker_load(struct brainfuck_worker *worker,
+                           struct brainfuck_state *state, char *bytes,
+                           size_t length) {
+  struct brainfuck_program_header header;
+  struct brainfuck_program loaded;
+  bool compiled = brainfuck_program_detect(bytes, length);
+  bool borrowed = false;
+  if (compiled) {
+    if (!brainfuck_program_read(bytes, length, &header, &loaded,
+                                &borrowed)) {
+      free(bytes);
+      return brainfuck_worker_error("invalid compiled program");
+    }
+  } else {
+    brainfuck_program_key(&header, bytes, length, worker->options,
+                          state->memory_limit);
+  }
+  struct brainfuck_batch_program *program =
+      brainfuck_worker_find(worker, header.key, state);
+  if (program == NULL && compiled &&
+      !brainfuck_compiled_compatible(state, &header, &loaded)) {
+    if (!borrowed) {
+      free(loaded.instructions);
+    }
+    free(bytes);
+    return brainfuck_worker_error("incompatible compiled program");
+  }
+  if (program == NULL) {
+    program = brainfuck_worker_add(worker);
+    if (program == NULL) {
+      free(bytes);
+      return brainfuck_worker_error("out of memory");
+    }
+    program->header = header;
+    program->compiled = compiled;
+    if (compiled) {
+      program->program = brainfuck_program_new();
+      if (program->program == NULL) {
+        if (!borrowed) {
+          free(loaded.instructions);
+        }
+        free(bytes);
+        return brainfuck_worker_error("out of memory");
+      }
+      *program->program = loaded;
+    } else {
+      program->program =
+          brainfuck_program_compile(bytes, length, worker->options);
+    }
+    if (program->program == NULL) {
+      free(bytes);
+      return brainfuck_worker_error("the program does not compile");
+    }
+    char path[BRAINFUCK_MAX_PATH_LENGTH];
+    if (!compiled && worker->options->cache &&
+        brainfuck_cache_path(path, sizeof(path), header.key)) {
+      brainfuck_cache_store(path, program->program, &header);
+    }
+    if (borrowed) {
+      /* The instructions are used in place for as long as the worker runs. */
+      program->bytes = bytes;
+      program->length = length;
+      bytes = NULL;
+    }
+    worker->program_count += 1;
+  } else if (compiled && !borrowed) {
+    free(loaded.instructions);
+  }
+  free(bytes);
+  uint8_t key[8];
+  brainfuck_store_le(key, header.key, sizeof(key));
+  return brainfuck_worker_reply('P', key, sizeof(key), NULL, 0);
+}
+
+/**
+ * @brief Run a job sent to a worker on one of its contexts.
+ * @param worker The worker.
+ * @param context The context to run the job on.
+ * @param bytes The job, after its kind.
+ * @param length The length of the job.
+ * @return True if the answer is written.
+ */
+bool brainfuck_worker_run(struct brainfuck_worker *worker,
+                          struct brainfuck_context *context,
+                          const uint8_t *bytes, size_t length) {
+  if (length < 24) {
+    return brainfuck_worker_error("truncated job");
+  }
+  uint64_t steps = brainfuck_load_le(bytes + 8, 8);
+  uint64_t timeout = brainfuck_load_le(bytes + 16, 8);
+  const struct brainfuck_batch_program *program = brainfuck_worker_find(
+      worker, brainfuck_load_le(bytes, 8), context->state);
+  if (program == NULL) {
+    return brainfuck_worker_error("unknown program");
+  }
+  struct brainfuck_batch_job job;
+  memset(&job, 0, sizeof(job));
+  job.input = bytes + 24;
+  job.input_end = bytes + length;
+  context->input_handler = brainfuck_input_handler_batch;
+  context->output_handler = brainfuck_output_handler_batch;
+  context->user_data = &job;
+  brainfuck_context_budget(context,
+                           steps == 0 ? worker->options->max_steps : steps,
+                           timeout == 0 ? worker->options->timeout : timeout);
+  struct brainfuck_stats before;
+  struct brainfuck_stats after;
+  brainfuck_context_stats(context, &before);
+  bool success = brainfuck_program_execute(context, program->program);
+  brainfuck_context_stats(context, &after);
+  uint8_t suspended = context->state->suspended;
+  int status = EXIT_SUCCESS;
+  if (suspended == BRAINFUCK_SUSPEND_STEPS ||
+      suspended == BRAINFUCK_SUSPEND_TIMEOUT) {
+    status = BRAINFUCK_EXIT_LIMIT;
+  } else if (!success || job.output_lost) {
+    status = EXIT_FAILURE;
+  }
+  uint8_t head[33];
+  head[0] = (uint8_t)status;
+  brainfuck_store_le(head + 1, after.loop_iterations - before.loop_iterations,
+                     8);
+  brainfuck_store_le(head + 9, after.bytes_in - before.bytes_in, 8);
+  brainfuck_store_le(head + 17, after.bytes_out - before.bytes_out, 8);
+  brainfuck_store_le(head + 25, after.execute_time - before.execute_time, 8);
+  bool written = brainfuck_worker_reply('J', head, sizeof(head), job.output,
+                                        job.output_size);
+  free(job.output);
+  return written;
+}
+
+/**
+ * @brief Serve jobs over the standard input and output, see
+ * `struct brainfuck_worker`, until the input ends.
+ * @param options The options of IBF.
+ * @return True if the input ends between two messages, false if it is cut
+ * short or an answer cannot be written.
+ */
+bool run_worker(const struct brainfuck_options *options) {
+  struct brainfuck_worker worker;
+  memset(&worker, 0, sizeof(worker));
+  worker.options = options;
+  /* The worker runs one job at a time, so one idle context is enough. */
+  worker.pool = brainfuck_pool_new(options, 1);
+  if (worker.pool == NULL) {
+    print_error_tape_allocation();
+    return false;
+  }
+  bool success = true;
+  while (success) {
+    uint8_t frame[4];
+    size_t read = fread(frame, 1, sizeof(frame), stdin);
+    if (read == 0 && feof(stdin)) {
+      break;
+    }
+    size_t length = (size_t)brainfuck_load_le(frame, sizeof(frame));
+    if (read == sizeof(frame) && length == 0) {
+      /* A message without even a kind is not one the worker knows. */
+      success = brainfuck_worker_error("unknown message");
+      continue;
+    }
+    char *bytes = read == sizeof(frame) ? malloc(length) : NULL;
+    if (bytes == NULL || fread(bytes, 1, length, stdin) != length) {
+      free(bytes);
+      print_error_read_input();
+      success = false;
+      break;
+    }
+    struct brainfuck_context *context =
+        brainfuck_pool_acquire(worker.pool, NULL, NULL, NULL);
+    if (context == NULL) {
+      free(bytes);
+      success = brainfuck_worker_error("cannot allocate the memory tape");
+      continue;
+    }
+    if (bytes[0] == 'P') {
+      /* The program is moved to the front of the message it came in. */
+      memmove(bytes, bytes + 1, length - 1);
+      success = brainfuck_worker_load(&worker, context->state, bytes,
+                                      length - 1);
+    } else if (bytes[0] == 'J') {
+      success = brainfuck_worker_run(&worker, context,
+                                     (const uint8_t *)bytes + 1, length - 1);
+      free(bytes);
+    } else {
+      free(bytes);
+      success = brainfuck_worker_error("unknown message");
+    }
+    brainfuck_pool_release(worker.pool, context);
+  }
+  for (size_t i = 0; i < worker.program_count; i += 1) {
+    struct brainfuck_batch_program *program = &worker.programs[i];
+    if (program->bytes != NULL) {
+      /* The borrowed instructions are not owned by the program. */
+      program->program->instructions = NULL;
+      brainfuck_batch_unload(program->bytes, program->length,
+                             program->mapped);
+    }
+    brainfuck_program_free(program->program);
+  }
+  free(worker.programs);
+  brainfuck_pool_free(worker.pool);
+  return success;
 }
 
 /**
@@ -656,7 +1942,9 @@ void print_version() {
  * @brief Print the usage of IBF.
  */
 void print_usage() {
-  fprintf(stderr, "usage: ibf [options] ... [-c cmd | file]\n");
+  fprintf(stderr,
+          "usage: ibf [options] ... [-c cmd | --batch manifest | --worker | "
+          "file]\n");
   fprintf(stderr, "Try `ibf -h` for more information.\n");
 }
 
@@ -664,12 +1952,76 @@ void print_usage() {
  * @brief Print the help of IBF.
  */
 void print_help() {
-  fprintf(stderr, "usage: ibf [options] ... [-c cmd | file]\n");
+  fprintf(stderr,
+          "usage: ibf [options] ... [-c cmd | --batch manifest | --worker | "
+          "file]\n");
   fprintf(stderr, "Options and arguments:\n");
   fprintf(stderr, "-v, --version\t  : Print the version of IBF.\n");
   fprintf(stderr, "-h, --help\t  : Print the help of IBF.\n");
   fprintf(stderr, "-c, --cmd\t  : Run program passed in as string. \n");
-  fprintf(stderr, "file\t\t  : Program read from script file.\n");
+  fprintf(stderr,
+          "-O, --optimize\t  : Set the optimization level (0-%d, default "
+          "%d).\n",
+          BRAINFUCK_MAX_OPTIMIZATION_LEVEL,
+          BRAINFUCK_DEFAULT_OPTIMIZATION_LEVEL);
+  fprintf(stderr,
+          "-e, --engine\t  : Set the engine (switch, threaded, jit, profile, "
+          "default\n\t\t    threaded).\n");
+  fprintf(stderr,
+          "--jit\t\t  : Run as native code, same as `--engine jit`.\n");
+  fprintf(stderr,
+          "--profile\t  : Count what a file or command runs and report its "
+          "hottest\n\t\t    loops and cells at exit, same as `--engine "
+          "profile`.\n");
+  fprintf(stderr,
+          "--stats\t\t  : Print the statistics of a file or command once it "
+          "is run.\n");
+  fprintf(stderr, "--emit-c\t  : Write the program as C instead of running.\n");
+  fprintf(stderr,
+          "--emit-asm\t  : Write the program as x86-64 assembly instead of "
+          "running.\n");
+  fprintf(stderr,
+          "--tape\t\t  : Set the tape (fixed, grow, guard, default "
+          "fixed).\n");
+  fprintf(stderr,
+          "--tape-size\t  : Set the cells of a fixed tape or the limit of a "
+          "growable\n\t\t    one (default %d or %zu).\n",
+          BRAINFUCK_MEMORY_BUFFER_SIZE, BRAINFUCK_GROW_MEMORY_LIMIT);
+  fprintf(stderr,
+          "--eof\t\t  : Set what `,` does at the end of input (exit, "
+          "unchanged, 0,\n\t\t    255, default exit).\n");
+  fprintf(stderr,
+          "--cache\t\t  : Reuse compiled programs from $XDG_CACHE_HOME/ibf.\n");
+  fprintf(stderr,
+          "--compile\t  : Write the compiled program instead of running.\n");
+  fprintf(stderr,
+          "-o, --output\t  : Write the compiled program or translation to a "
+          "file.\n");
+  fprintf(stderr,
+          "--batch\t\t  : Run the programs listed in a manifest in parallel, "
+          "one\n\t\t    `program [input]` per line, writing their outputs "
+          "in order.\n");
+  fprintf(stderr,
+          "--jobs\t\t  : Set the threads of a batch (default one per "
+          "processor).\n");
+  fprintf(stderr,
+          "--worker\t  : Serve programs and jobs sent over the standard "
+          "input, and\n\t\t    answer on the standard output, until the "
+          "input ends.\n");
+  fprintf(stderr,
+          "--max-steps\t  : Stop a run after this many loop iterations, "
+          "exiting with %d.\n",
+          BRAINFUCK_EXIT_LIMIT);
+  fprintf(stderr,
+          "--timeout\t  : Stop a run after this many milliseconds, exiting "
+          "with %d.\n",
+          BRAINFUCK_EXIT_LIMIT);
+  fprintf(stderr,
+          "--fold\t\t  : Run the start of a file up to its first `,` at "
+          "compile time,\n\t\t    for up to this many loop iterations.\n");
+  fprintf(stderr,
+          "file\t\t  : Program read from script file, or a compiled "
+          "program.\n");
 }
 
 /**
@@ -677,17 +2029,60 @@ void print_help() {
  * Version: -v, --version. Print the version of the program.
  * Help: -h, --help. Print the help of the program.
  * Command: -c, --command. Run the command from the command line.
+ * Optimize: -O, --optimize. Set the optimization level.
+ * Engine: -e, --engine. Set the execution engine.
+ * JIT: --jit. Run as native code where supported.
+ * Profile: --profile. Report where a program spends its time.
+ * Statistics: --stats. Print what a run counted once it is over.
+ * Emit: --emit-c, --emit-asm. Write the compiled program instead of running.
+ * Tape: --tape, --tape-size. Choose the memory tape and its number of cells.
+ * EOF: --eof. Choose what `,` does at the end of the input.
+ * Cache: --cache. Reuse compiled programs across runs.
+ * Compile: --compile, -o, --output. Write a compiled program file, or any
+ * translation, to a file.
+ * Batch: --batch, --jobs. Run the programs of a manifest on many threads.
+ * Worker: --worker. Serve jobs sent by a coordinator over a pipe.
+ * Limits: --max-steps, --timeout. Stop runs that loop for too long.
+ * Fold: --fold. Run the start of a program when it is compiled.
  */
 static struct option long_options[] = {{"version", no_argument, 0, 'v'},
                                        {"help", no_argument, 0, 'h'},
                                        {"cmd", required_argument, 0, 'c'},
+                                       {"optimize", required_argument, 0, 'O'},
+                                       {"engine", required_argument, 0, 'e'},
+                                       {"jit", no_argument, 0, 'j'},
+                                       {"profile", no_argument, 0, 'P'},
+                                       {"stats", no_argument, 0, 's'},
+                                       {"emit-c", no_argument, 0, 'C'},
+                                       {"emit-asm", no_argument, 0, 'S'},
+                                       {"tape", required_argument, 0, 't'},
+                                       {"tape-size", required_argument, 0,
+                                        'T'},
+                                       {"eof", required_argument, 0, 'E'},
+                                       {"cache", no_argument, 0, 'K'},
+                                       {"compile", no_argument, 0, 'B'},
+                                       {"output", required_argument, 0, 'o'},
+                                       {"batch", required_argument, 0, 'b'},
+                                       {"jobs", required_argument, 0, 'J'},
+                                       {"worker", no_argument, 0, 'W'},
+                                       {"max-steps", required_argument, 0,
+                                        'M'},
+                                       {"timeout", required_argument, 0, 'L'},
+                                       {"fold", required_argument, 0, 'F'},
                                        {0, 0, 0, 0}};
 
 int main(int argc, char *argv[]) {
+  /* Output is buffered until input is read from a terminal, or until exit. */
+  atexit(brainfuck_stdout_flush);
+  struct brainfuck_options options = brainfuck_options_default();
+  char *command = NULL;
+  char *manifest = NULL;
+  bool worker = false;
+  size_t jobs = 0;
   while (true) {
     int option_index = 0;
     /* Parse the options. */
-    int c = getopt_long(argc, argv, ":vhc:", long_options, &option_index);
+    int c = getopt_long(argc, argv, ":vhc:O:e:o:", long_options, &option_index);
     if (c == -1) {
       break;
     }
@@ -703,11 +2098,152 @@ int main(int argc, char *argv[]) {
       case 'h': /* Help. */
         print_help();
         return EXIT_SUCCESS;
-      case 'c': /* Command. */
-        if (!run_command(optarg)) {
+      case 'c': /* Command, run once all options are parsed. */
+        command = optarg;
+        break;
+      case 'O': { /* Optimization level. */
+        char *end = NULL;
+        long level = strtol(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0' || level < 0 ||
+            level > BRAINFUCK_MAX_OPTIMIZATION_LEVEL) {
+          fprintf(stderr, "Invalid optimization level %s\n", optarg);
+          print_usage();
           return EXIT_FAILURE;
         }
-        return EXIT_SUCCESS;
+        options.optimization_level = (uint8_t)level;
+        break;
+      }
+      case 'e': /* Engine. */
+        if (strcmp(optarg, "switch") == 0) {
+          options.engine = BRAINFUCK_ENGINE_SWITCH;
+        } else if (strcmp(optarg, "threaded") == 0) {
+          options.engine = BRAINFUCK_ENGINE_THREADED;
+        } else if (strcmp(optarg, "jit") == 0) {
+          options.engine = BRAINFUCK_ENGINE_JIT;
+        } else if (strcmp(optarg, "profile") == 0) {
+          options.engine = BRAINFUCK_ENGINE_PROFILE;
+        } else {
+          fprintf(stderr, "Unknown engine %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'j': /* JIT. */
+        options.engine = BRAINFUCK_ENGINE_JIT;
+        break;
+      case 'P': /* Profile. */
+        options.engine = BRAINFUCK_ENGINE_PROFILE;
+        break;
+      case 's': /* Statistics. */
+        options.stats = true;
+        break;
+      case 'C': /* Emit C. */
+        options.emit = BRAINFUCK_EMIT_C;
+        break;
+      case 'S': /* Emit assembly. */
+        options.emit = BRAINFUCK_EMIT_ASM;
+        break;
+      case 't': /* Tape. */
+        if (strcmp(optarg, "fixed") == 0) {
+          options.tape = BRAINFUCK_TAPE_FIXED;
+        } else if (strcmp(optarg, "grow") == 0) {
+          options.tape = BRAINFUCK_TAPE_GROW;
+        } else if (strcmp(optarg, "guard") == 0) {
+          options.tape = BRAINFUCK_TAPE_GUARD;
+        } else {
+          fprintf(stderr, "Unknown tape %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'B': /* Compile. */
+        options.emit = BRAINFUCK_EMIT_BYTECODE;
+        break;
+      case 'o': /* Output. */
+        options.output = optarg;
+        break;
+      case 'b': /* Batch, run once all options are parsed. */
+        manifest = optarg;
+        break;
+      case 'W': /* Worker, run once all options are parsed. */
+        worker = true;
+        break;
+      case 'J': { /* Threads of a batch. */
+        char *end = NULL;
+        errno = 0;
+        unsigned long long count = strtoull(optarg, &end, 10);
+        if (!isdigit((unsigned char)*optarg) || *end != '\0' || errno != 0 ||
+            count == 0 || count != (size_t)count) {
+          fprintf(stderr, "Invalid number of jobs %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        jobs = (size_t)count;
+        break;
+      }
+      case 'F': { /* Fold budget. */
+        char *end = NULL;
+        errno = 0;
+        unsigned long long steps = strtoull(optarg, &end, 10);
+        if (!isdigit((unsigned char)*optarg) || *end != '\0' || errno != 0 ||
+            steps == 0) {
+          fprintf(stderr, "Invalid fold budget %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        options.fold_steps = (uint64_t)steps;
+        break;
+      }
+      case 'M':   /* Step limit. */
+      case 'L': { /* Time limit. */
+        char *end = NULL;
+        errno = 0;
+        unsigned long long limit = strtoull(optarg, &end, 10);
+        if (!isdigit((unsigned char)*optarg) || *end != '\0' || errno != 0 ||
+            limit == 0) {
+          fprintf(stderr, "Invalid %s %s\n",
+                  c == 'M' ? "step limit" : "timeout", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        if (c == 'M') {
+          options.max_steps = (uint64_t)limit;
+        } else {
+          options.timeout = (uint64_t)limit;
+        }
+        break;
+      }
+      case 'K': /* Cache. */
+        options.cache = true;
+        break;
+      case 'E': /* End of input. */
+        if (strcmp(optarg, "exit") == 0) {
+          options.eof = BRAINFUCK_EOF_EXIT;
+        } else if (strcmp(optarg, "unchanged") == 0) {
+          options.eof = BRAINFUCK_EOF_UNCHANGED;
+        } else if (strcmp(optarg, "0") == 0) {
+          options.eof = BRAINFUCK_EOF_ZERO;
+        } else if (strcmp(optarg, "255") == 0) {
+          options.eof = BRAINFUCK_EOF_MAX;
+        } else {
+          fprintf(stderr, "Unknown end of input %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'T': { /* Tape size. */
+        char *end = NULL;
+        errno = 0;
+        unsigned long long size = strtoull(optarg, &end, 10);
+        if (!isdigit((unsigned char)*optarg) || *end != '\0' || errno != 0 ||
+            size == 0 || size != (size_t)size) {
+          fprintf(stderr, "Invalid tape size %s\n", optarg);
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        options.tape_size = (size_t)size;
+        break;
+      }
       case '?': /* Unknown option. */
         fprintf(stderr, "Unknown option %s\n", argv[optind - 1]);
         print_usage();
@@ -721,27 +2257,48 @@ int main(int argc, char *argv[]) {
         abort();
     }
   }
+  if (manifest != NULL) {
+    if (options.emit != BRAINFUCK_EMIT_NONE) {
+      fprintf(stderr, "A batch cannot be translated or compiled\n");
+      print_usage();
+      return EXIT_FAILURE;
+    }
+    return brainfuck_exit_status(run_batch(manifest, jobs, &options));
+  }
+  if (worker) {
+    if (options.emit != BRAINFUCK_EMIT_NONE) {
+      fprintf(stderr, "A worker cannot translate or compile\n");
+      print_usage();
+      return EXIT_FAILURE;
+    }
+    return run_worker(&options) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (command != NULL) {
+    return brainfuck_exit_status(run_command(command, &options));
+  }
   /* If there is no argument, run interactively in the console or from a file.
    */
-  if (argc > 1) {
+  if (optind < argc) {
     /* Run from a file. */
-    FILE *file = fopen(argv[1], "r");
+    FILE *file = fopen(argv[optind], "rb");
     if (file == NULL) {
       fprintf(stderr, "%s: Cannot open file '%s': [Errno %d] %s\n", argv[0],
-              argv[1], errno, strerror(errno));
+              argv[optind], errno, strerror(errno));
       return EXIT_FAILURE;
     }
-    if (!run_file(file)) {
+    if (!run_file(file, &options)) {
       fclose(file);
-      return EXIT_FAILURE;
+      return brainfuck_exit_status(false);
     }
     fclose(file);
   } else {
     /* Run interactively in the console. */
     if (isatty(STDIN_FILENO)) {
-      run_console();
-    } else {
-      run_file(stdin);
+      if (!run_console(&options)) {
+        return EXIT_FAILURE;
+      }
+    } else if (!run_file(stdin, &options)) {
+      return brainfuck_exit_status(false);
     }
   }
   return EXIT_SUCCESS;
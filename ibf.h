@@ -0,0 +1,411 @@
+#ifndef IBF_H
+#define IBF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define IBF_VERSION_MAJOR 0
+#define IBF_VERSION_MINOR 1
+#define IBF_VERSION_PATCH 0
+
+#define BRAINFUCK_MEMORY_BUFFER_SIZE 30000
+#define BRAINFUCK_GROW_MEMORY_LIMIT ((size_t)1 << 30)
+#define BRAINFUCK_PROGRAM_MAGIC "IBF\x7f"
+#define BRAINFUCK_PROGRAM_VERSION 3
+#define BRAINFUCK_PROGRAM_HEADER_SIZE 48
+#define BRAINFUCK_PROGRAM_INSTRUCTION_SIZE 12
+#define BRAINFUCK_MAX_LOOP_DEPTH 65536
+#define BRAINFUCK_MAX_PROGRAM_SIZE INT32_MAX
+#define BRAINFUCK_MAX_OPTIMIZATION_LEVEL 2
+#define BRAINFUCK_DEFAULT_OPTIMIZATION_LEVEL 2
+#define BRAINFUCK_BUDGET_SLICE 65536
+#define BRAINFUCK_CONTEXT_OUTPUT_SIZE 4096
+#define BRAINFUCK_JIT_CACHE_SIZE 8
+
+/**
+ * @brief The input handler of IBF.
+ * @param user_data The user data of the context.
+ * @param value Set to the character to input.
+ * @return False at the end of the input, leaving the value as it is.
+ */
+typedef bool (*brainfuck_input_handler)(void *user_data, uint8_t *value);
+
+/**
+ * @brief The output handler of IBF.
+ * @param user_data The user data of the context.
+ * @param buffer The bytes to output.
+ * @param length The number of bytes to output.
+ */
+typedef void (*brainfuck_output_handler)(void *user_data,
+                                         const uint8_t *buffer, size_t length);
+
+/**
+ * @brief The opcodes of a compiled IBF program.
+ */
+enum brainfuck_opcode {
+  BRAINFUCK_OP_ADD,        /* Add the argument to the current cell. */
+  BRAINFUCK_OP_MOVE,       /* Move the memory pointer by the argument. */
+  BRAINFUCK_OP_INPUT,      /* Read a byte into the current cell. */
+  BRAINFUCK_OP_OUTPUT,     /* Write the current cell argument times. */
+  BRAINFUCK_OP_LOOP_START, /* Jump past the matching end if zero. */
+  BRAINFUCK_OP_LOOP_END,   /* Jump back after the matching start if nonzero. */
+  BRAINFUCK_OP_SET,        /* Set the cell at the offset to the argument. */
+  BRAINFUCK_OP_MUL,        /* Add the current cell times the argument to the
+                              cell at the offset. */
+  BRAINFUCK_OP_SCAN,       /* Move by the argument until a zero cell. */
+};
+
+#define BRAINFUCK_OPCODE_COUNT (BRAINFUCK_OP_SCAN + 1)
+
+/**
+ * @brief An instruction of a compiled IBF program.
+ */
+struct brainfuck_instruction {
+  uint8_t opcode;   /* The opcode, see `enum brainfuck_opcode`. */
+  int32_t offset;   /* The offset of the cell to the memory pointer. */
+  int32_t argument; /* The amount, distance or matching loop index. */
+};
+
+/**
+ * @brief What a compiled program file records besides the instructions.
+ * All of its integers are little-endian. The magic `IBF\x7f` and the 32-bit
+ * version are followed, at 8, by the 64-bit key, the number of
+ * instructions, the deepest loop nesting and the cells of the tape, then by
+ * the kind of tape at 40 and the optimization level at 41. From byte 48,
+ * each instruction takes 12 bytes: the opcode, 3 zero bytes, then the
+ * 32-bit offset and argument, with loops already resolved.
+ */
+struct brainfuck_program_header {
+  uint64_t key;               /* The hash of the source and of its options. */
+  size_t memory_size;         /* The cells, or the growth limit, of the tape. */
+  uint8_t tape;               /* The kind of tape it was optimized for. */
+  uint8_t optimization_level; /* The level it was optimized at. */
+};
+
+/**
+ * @brief A compiled IBF program.
+ */
+struct brainfuck_program {
+  struct brainfuck_instruction *instructions; /* The instructions. */
+  size_t size;                                /* The number of instructions. */
+  size_t capacity;                            /* The allocated instructions. */
+  size_t max_depth;                           /* The deepest loop nesting. */
+  size_t *sources; /* The source offset of each instruction, NULL if they are
+                      not tracked. */
+};
+
+/**
+ * @brief A buffer of bytes, read from `begin` up to `end`.
+ */
+struct brainfuck_buffer {
+  uint8_t *bytes;  /* The bytes. */
+  size_t begin;    /* The first byte not read yet. */
+  size_t end;      /* The end of the bytes written. */
+  size_t capacity; /* The allocated bytes. */
+};
+
+/**
+ * @brief The statistics of a context, counted over its whole life. Times
+ * are in nanoseconds.
+ */
+struct brainfuck_stats {
+  uint64_t runs;            /* The programs and typed loops executed. */
+  uint64_t loop_iterations; /* The loop iterations, as the budget counts
+                               them. */
+  uint64_t loops_compiled;  /* The loops compiled. */
+  uint64_t loops_optimized; /* The loops the optimizer replaced. */
+  uint64_t cache_hits;      /* The programs loaded from the cache. */
+  uint64_t cache_misses;    /* The programs the cache did not have. */
+  uint64_t bytes_in;        /* The bytes read by `,`. */
+  uint64_t bytes_out;       /* The bytes written by `.`. */
+  size_t tape_extent;       /* The most cells in use, up to the last one
+                               pointed at or holding a value. */
+  size_t max_loop_depth;    /* The deepest loop nesting compiled. */
+  uint64_t parse_time;      /* The time spent compiling source. */
+  uint64_t optimize_time;   /* The time spent optimizing programs. */
+  uint64_t execute_time;    /* The time spent executing programs. */
+};
+
+/**
+ * @brief The state of IBF.
+ */
+struct brainfuck_state {
+  uint8_t *memory_buffer;                /* The memory buffer. */
+  size_t memory_pointer;                 /* The memory pointer. */
+  size_t memory_size;                    /* The accessible cells. */
+  size_t memory_limit;                   /* The cells the tape can hold. */
+  size_t memory_guard;                   /* The guard on each side. */
+  uint8_t tape;                          /* The kind of tape. */
+  bool memory_mapped;                    /* Whether the tape is mapped. */
+  size_t unmatched_depth;                /* The unmatched depth of loop. */
+  size_t *loop_stack;                    /* The stack of unmatched loops. */
+  size_t loop_stack_capacity;            /* The allocated loop stack. */
+  struct brainfuck_program loop_program; /* The compiled buffered loop. */
+  void **threaded_code;                  /* The threaded handlers. */
+  size_t threaded_capacity;              /* The allocated threaded handlers. */
+  uint64_t fuel;     /* The loop iterations before the budget is checked. */
+  uint64_t steps;    /* The loop iterations of the budget beyond the fuel. */
+  uint64_t deadline; /* The clock time, in nanoseconds, the run stops at, 0 for
+                        none. */
+  size_t resume_pointer; /* The instruction a suspended run resumes at. */
+  uint8_t suspended; /* Why the run is suspended, see `enum brainfuck_suspend`,
+                        or `BRAINFUCK_SUSPEND_NONE`. */
+  struct brainfuck_buffer input;  /* The input fed to a context without an
+                                     input handler. */
+  bool input_ended;               /* Whether no more input is fed. */
+  struct brainfuck_buffer output; /* The output of a context without an
+                                     output handler. */
+  size_t output_pending; /* The bytes the suspended `.` has left to write. */
+  bool quiet;            /* Whether errors of the run are not reported. */
+  struct brainfuck_stats stats; /* The statistics, see
+                                   `brainfuck_context_stats`. */
+};
+
+/**
+ * @brief Why a run stops before the end of its program, in a state it can
+ * be resumed from.
+ */
+enum brainfuck_suspend {
+  BRAINFUCK_SUSPEND_NONE,    /* The run is not suspended. */
+  BRAINFUCK_SUSPEND_STEPS,   /* The loop iterations of the budget are spent. */
+  BRAINFUCK_SUSPEND_TIMEOUT, /* The time of the budget is spent. */
+  BRAINFUCK_SUSPEND_INPUT,   /* `,` needs input that is not fed yet. */
+  BRAINFUCK_SUSPEND_OUTPUT,  /* `.` finds the output buffer full. */
+};
+
+/**
+ * @brief The execution engines of IBF.
+ */
+enum brainfuck_engine {
+  BRAINFUCK_ENGINE_SWITCH,   /* The reference interpreter. */
+  BRAINFUCK_ENGINE_THREADED, /* The threaded interpreter. */
+  BRAINFUCK_ENGINE_JIT,      /* The native code compiler. */
+  BRAINFUCK_ENGINE_PROFILE,  /* The reference interpreter, counting what it
+                                runs into the profile of the context. */
+};
+
+/**
+ * @brief The translations IBF can write instead of running a program.
+ */
+enum brainfuck_emit {
+  BRAINFUCK_EMIT_NONE,     /* Run the program. */
+  BRAINFUCK_EMIT_C,        /* Write a standalone C translation unit. */
+  BRAINFUCK_EMIT_ASM,      /* Write x86-64 assembly for the GNU assembler. */
+  BRAINFUCK_EMIT_BYTECODE, /* Write a compiled program file to run later. */
+};
+
+/**
+ * @brief The kinds of memory tape of IBF.
+ */
+enum brainfuck_tape {
+  BRAINFUCK_TAPE_FIXED, /* A fixed number of cells, wrapping around. */
+  BRAINFUCK_TAPE_GROW,  /* Cells reserved up front and committed on use. */
+  BRAINFUCK_TAPE_GUARD, /* Whole pages of cells between inaccessible guards. */
+};
+
+/**
+ * @brief What `,` does at the end of the input.
+ */
+enum brainfuck_eof {
+  BRAINFUCK_EOF_EXIT,      /* Stop the program with a failure. */
+  BRAINFUCK_EOF_UNCHANGED, /* Leave the current cell unchanged. */
+  BRAINFUCK_EOF_ZERO,      /* Set the current cell to 0. */
+  BRAINFUCK_EOF_MAX,       /* Set the current cell to 255. */
+};
+
+/**
+ * @brief The options of IBF.
+ */
+struct brainfuck_options {
+  uint8_t optimization_level; /* The optimization level of compiled loops. */
+  uint8_t engine;             /* The engine, see `enum brainfuck_engine`. */
+  uint8_t emit;               /* The translation, see `enum brainfuck_emit`. */
+  uint8_t tape;               /* The kind of tape, see `enum brainfuck_tape`. */
+  uint8_t eof;                /* The end of input, see `enum brainfuck_eof`. */
+  bool cache;                 /* Whether compiled programs are cached. */
+  const char *output; /* The file translations are written to, NULL for the
+                         standard output. */
+  size_t tape_size; /* The number of cells, or the growth limit, 0 for the
+                       default of the kind of tape. */
+  uint64_t max_steps; /* The loop iterations of a run, 0 for no limit. */
+  uint64_t timeout;   /* The milliseconds of a run, 0 for no limit. */
+  bool stats;         /* Whether statistics are printed after a run. */
+  uint64_t fold_steps; /* The loop iterations the start of a program is run
+                          for ahead of time, 0 to run none of it. */
+};
+
+/**
+ * @brief What the profile engine counts while it runs a program. A loop
+ * start counts the entries of its loop and a loop end its iterations.
+ */
+struct brainfuck_profile {
+  uint64_t *counts;  /* The executions of each instruction. */
+  uint64_t *follows; /* The times each instruction ran straight on into the
+                        next one. */
+  uint64_t *chains;  /* The times each instruction ran straight on into the
+                        next two. */
+  uint64_t *times;   /* The nanoseconds spent in each top-level loop, at the
+                        index of its start. */
+  size_t size;       /* The instructions counted. */
+  uint64_t *cells;   /* The accesses of each cell, up to the last accessed. */
+  size_t cells_size; /* The cells counted. */
+  size_t loop;       /* The top-level loop being timed, SIZE_MAX for none. */
+  uint64_t entered;  /* The clock time the timed loop was entered or resumed
+                        at. */
+};
+
+/**
+ * @brief The native code of a program compiled by the JIT engine.
+ */
+struct brainfuck_jit_native {
+  struct brainfuck_instruction *instructions; /* The program compiled. */
+  size_t size;     /* The number of instructions. */
+  bool checked;    /* Whether cells are checked against the memory. */
+  uint8_t *region; /* The executable code. */
+  size_t length;   /* The size of the executable code. */
+  uint32_t *entries; /* The position of the code of each instruction a run
+                        may resume at, UINT32_MAX for the others. */
+  uint64_t used;     /* The clock of the cache it was last run at. */
+};
+
+/**
+ * @brief The native code of the programs a context ran last, so that
+ * running or resuming them again compiles nothing.
+ */
+struct brainfuck_jit_cache {
+  struct brainfuck_jit_native
+      natives[BRAINFUCK_JIT_CACHE_SIZE]; /* The programs, with no region for
+                                            an unused one. */
+  uint64_t clock; /* Counts the runs, to replace the least recently run. */
+};
+
+/**
+ * @brief The context of IBF. Without an input handler, `,` reads the input
+ * fed with `brainfuck_context_feed`, and without an output handler, `.`
+ * writes to a buffer taken with `brainfuck_context_output`. Either way the
+ * run is suspended instead of waiting, so that one thread can drive many
+ * interactive programs.
+ */
+struct brainfuck_context {
+  struct brainfuck_state *state;           /* The state of IBF. */
+  brainfuck_input_handler input_handler;   /* The input handler of IBF. */
+  brainfuck_output_handler output_handler; /* The output handler of IBF. */
+  void *user_data;                         /* Passed to both handlers. */
+  struct brainfuck_options options;        /* The options of IBF. */
+  struct brainfuck_profile *profile; /* The profile of the profile engine, NULL
+                                        for other engines. */
+  struct brainfuck_jit_cache *jit; /* The native code of the JIT engine, NULL
+                                      until it runs. */
+};
+
+/**
+ * @brief A pool of contexts with the same options, so that many short runs
+ * reuse tapes and buffers instead of allocating them. A pool is not
+ * thread-safe, each thread keeps its own.
+ */
+struct brainfuck_pool {
+  struct brainfuck_options options;    /* The options of every context. */
+  struct brainfuck_context **contexts; /* The idle contexts. */
+  size_t size;                         /* The number of idle contexts. */
+  size_t capacity;                     /* The idle contexts kept at most. */
+};
+
+/**
+ * @brief A snapshot of the tape, the memory pointer and the open loop of a
+ * context, to be restored later. The tape is kept in pages, and a page of
+ * zeros is not copied at all.
+ */
+struct brainfuck_snapshot {
+  uint8_t **pages;                       /* The pages of the tape, NULL for a
+                                            page of zeros. */
+  size_t pages_size;                     /* The number of pages. */
+  size_t memory_size;                    /* The accessible cells. */
+  size_t memory_pointer;                 /* The memory pointer. */
+  size_t unmatched_depth;                /* The unmatched depth of loop. */
+  size_t *loop_stack;                    /* The stack of unmatched loops. */
+  struct brainfuck_program loop_program; /* The compiled buffered loop. */
+};
+
+/* Options and contexts. A context runs programs on its own tape, a snapshot
+ * keeps a copy of that tape to go back to, and a pool keeps contexts around
+ * to be reset and reused. */
+struct brainfuck_options brainfuck_options_default();
+struct brainfuck_context *brainfuck_context_new(
+    brainfuck_input_handler input_handler,
+    brainfuck_output_handler output_handler, void *user_data,
+    const struct brainfuck_options *options);
+void brainfuck_context_reset(struct brainfuck_context *context);
+void brainfuck_context_budget(struct brainfuck_context *context,
+                              uint64_t steps, uint64_t timeout);
+bool brainfuck_context_feed(struct brainfuck_context *context,
+                            const uint8_t *bytes, size_t length, bool end);
+const uint8_t *brainfuck_context_output(struct brainfuck_context *context,
+                                        size_t *length);
+void brainfuck_context_stats(struct brainfuck_context *context,
+                             struct brainfuck_stats *stats);
+struct brainfuck_snapshot *brainfuck_snapshot_save(
+    const struct brainfuck_context *context);
+bool brainfuck_snapshot_restore(struct brainfuck_context *context,
+                                const struct brainfuck_snapshot *snapshot);
+void brainfuck_snapshot_free(struct brainfuck_snapshot *snapshot);
+void brainfuck_context_free(struct brainfuck_context *context);
+struct brainfuck_pool *brainfuck_pool_new(
+    const struct brainfuck_options *options, size_t capacity);
+struct brainfuck_context *brainfuck_pool_acquire(
+    struct brainfuck_pool *pool, brainfuck_input_handler input_handler,
+    brainfuck_output_handler output_handler, void *user_data);
+void brainfuck_pool_release(struct brainfuck_pool *pool,
+                            struct brainfuck_context *context);
+void brainfuck_pool_free(struct brainfuck_pool *pool);
+
+/* Programs. A program is compiled once and executed on any context created
+ * with the same options. A run that spends the budget of its context, or
+ * waits for input or output without a handler, fails with the reason in
+ * `state->suspended`, and can be resumed once the reason is dealt with. */
+struct brainfuck_program *brainfuck_program_new();
+void brainfuck_program_free(struct brainfuck_program *program);
+bool brainfuck_program_track(struct brainfuck_program *program);
+struct brainfuck_program *brainfuck_program_compile(
+    const char *src, size_t length, const struct brainfuck_options *options);
+bool brainfuck_compile(struct brainfuck_state *state,
+                       struct brainfuck_program *program, const char *src,
+                       size_t length);
+bool brainfuck_optimize(struct brainfuck_state *state,
+                        struct brainfuck_program *program, uint8_t level);
+bool brainfuck_program_fold(struct brainfuck_program *program,
+                            const struct brainfuck_options *options);
+bool brainfuck_program_execute(struct brainfuck_context *context,
+                               const struct brainfuck_program *program);
+bool brainfuck_program_resume(struct brainfuck_context *context,
+                              const struct brainfuck_program *program);
+bool brainfuck_main(struct brainfuck_context *context, char *src);
+
+/* Compiled program files and translations. */
+uint64_t brainfuck_hash(const void *data, size_t length, uint64_t seed);
+void brainfuck_store_le(uint8_t *bytes, uint64_t value, size_t width);
+uint64_t brainfuck_load_le(const uint8_t *bytes, size_t width);
+bool brainfuck_program_validate(struct brainfuck_state *state,
+                                const struct brainfuck_program *program);
+bool brainfuck_program_detect(const char *bytes, size_t length);
+bool brainfuck_program_write(FILE *stream,
+                             const struct brainfuck_program *program,
+                             const struct brainfuck_program_header *header);
+bool brainfuck_program_read(const char *bytes, size_t length,
+                            struct brainfuck_program_header *header,
+                            struct brainfuck_program *program,
+                            bool *borrowed);
+void brainfuck_emit_c(FILE *stream, const struct brainfuck_program *program,
+                      size_t size, uint8_t eof);
+void brainfuck_emit_asm(FILE *stream, const struct brainfuck_program *program,
+                        size_t size, uint8_t eof);
+void brainfuck_profile_report(FILE *stream,
+                              const struct brainfuck_profile *profile,
+                              const struct brainfuck_program *program);
+
+/* Errors reported on the standard error. */
+void print_error_unmatched_loop_end();
+void print_error_unmatched_loop_start();
+
+#endif
@@ -0,0 +1,4832 @@
+#include "ibf.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BRAINFUCK_SCAN_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BRAINFUCK_SCAN_WIDTH 16
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BRAINFUCK_SCAN_WIDTH 16
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32)
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define BRAINFUCK_HAVE_MMAP
+#endif
+#if defined(__x86_64__) && defined(BRAINFUCK_HAVE_MMAP)
+#define BRAINFUCK_JIT_X86_64
+#endif
+
+#define BRAINFUCK_TOKEN_PLUS '+'
+#define BRAINFUCK_TOKEN_MINUS '-'
+#define BRAINFUCK_TOKEN_PREVIOUS '<'
+#define BRAINFUCK_TOKEN_NEXT '>'
+#define BRAINFUCK_TOKEN_OUTPUT '.'
+#define BRAINFUCK_TOKEN_INPUT ','
+#define BRAINFUCK_TOKEN_LOOP_START '['
+#define BRAINFUCK_TOKEN_LOOP_END ']'
+
+#define BRAINFUCK_GROW_CHUNK_SIZE 65536
+#define BRAINFUCK_MAX_DISTANCE (1 << 30)
+#define BRAINFUCK_GUARD_SIZE ((size_t)BRAINFUCK_MAX_DISTANCE * 2)
+#define BRAINFUCK_PROFILE_LOOPS 10
+#define BRAINFUCK_PROFILE_ROWS 16
+#define BRAINFUCK_PROFILE_BAR 40
+#define BRAINFUCK_PROFILE_SEQUENCES 10
+#define BRAINFUCK_JIT_BLOCK_SIZE 8
+#define BRAINFUCK_SNAPSHOT_PAGE_SIZE 4096
+#define BRAINFUCK_FOLD_OUTPUT_SIZE 65536
+
+/**
+ * @brief Get the default options of IBF.
+ * @return The default options of IBF.
+ */
+struct brainfuck_options brainfuck_options_default() {
+  struct brainfuck_options options;
+  options.optimization_level = BRAINFUCK_DEFAULT_OPTIMIZATION_LEVEL;
+  options.engine = BRAINFUCK_ENGINE_THREADED;
+  options.emit = BRAINFUCK_EMIT_NONE;
+  options.tape = BRAINFUCK_TAPE_FIXED;
+  options.eof = BRAINFUCK_EOF_EXIT;
+  options.cache = false;
+  options.output = NULL;
+  options.tape_size = 0;
+  options.max_steps = 0;
+  options.timeout = 0;
+  options.stats = false;
+  options.fold_steps = 0;
+  return options;
+}
+
+/**
+ * @brief Allocate the memory tape of a state. A growable tape reserves
+ * address space for all of its cells, but only commits the first chunk, so
+ * that untouched cells cost nothing and the reserved rest guards the tape.
+ * A guarded tape is surrounded by inaccessible memory, so that running off
+ * it faults instead of needing a bounds check.
+ * @param state The state of IBF.
+ * @param tape The kind of tape, see `enum brainfuck_tape`.
+ * @param size The number of cells, or the growth limit, 0 for the default.
+ * @return True if the tape is allocated successfully.
+ */
+bool brainfuck_tape_allocate(struct brainfuck_state *state, uint8_t tape,
+                             size_t size) {
+  state->tape = tape;
+  state->memory_mapped = false;
+  state->memory_guard = 0;
+  if (tape == BRAINFUCK_TAPE_GUARD) {
+    state->memory_size = size == 0 ? BRAINFUCK_MEMORY_BUFFER_SIZE : size;
+#if defined(BRAINFUCK_HAVE_MMAP)
+    /* The tape ends where the guard starts, so it is rounded up to pages. */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (state->memory_size > SIZE_MAX - BRAINFUCK_GUARD_SIZE * 2 - page) {
+      return false;
+    }
+    state->memory_size = (state->memory_size + page - 1) / page * page;
+    state->memory_limit = state->memory_size;
+    uint8_t *region =
+        mmap(NULL, state->memory_size + BRAINFUCK_GUARD_SIZE * 2, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+      return false;
+    }
+    if (mprotect(region + BRAINFUCK_GUARD_SIZE, state->memory_size,
+                 PROT_READ | PROT_WRITE) != 0) {
+      munmap(region, state->memory_size + BRAINFUCK_GUARD_SIZE * 2);
+      return false;
+    }
+    state->memory_buffer = region + BRAINFUCK_GUARD_SIZE;
+    state->memory_guard = BRAINFUCK_GUARD_SIZE;
+    state->memory_mapped = true;
+    return true;
+#endif
+    /* Without guards, the tape is checked like a growable one at its limit. */
+    state->memory_limit = state->memory_size;
+  } else if (tape == BRAINFUCK_TAPE_GROW) {
+    state->memory_limit = size == 0 ? BRAINFUCK_GROW_MEMORY_LIMIT : size;
+    state->memory_size = state->memory_limit < BRAINFUCK_GROW_CHUNK_SIZE
+                             ? state->memory_limit
+                             : BRAINFUCK_GROW_CHUNK_SIZE;
+#if defined(BRAINFUCK_HAVE_MMAP)
+    void *region = mmap(NULL, state->memory_limit, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+      return false;
+    }
+    if (mprotect(region, state->memory_size, PROT_READ | PROT_WRITE) != 0) {
+      munmap(region, state->memory_limit);
+      return false;
+    }
+    state->memory_buffer = region;
+    state->memory_mapped = true;
+    return true;
+#endif
+  } else {
+    state->memory_size = size == 0 ? BRAINFUCK_MEMORY_BUFFER_SIZE : size;
+    state->memory_limit = state->memory_size;
+  }
+  state->memory_buffer = calloc(state->memory_size, sizeof(uint8_t));
+  return state->memory_buffer != NULL;
+}
+
+/**
+ * @brief Free the memory tape of a state.
+ * @param state The state of IBF.
+ */
+void brainfuck_tape_free(struct brainfuck_state *state) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  if (state->memory_mapped) {
+    munmap(state->memory_buffer - state->memory_guard,
+           state->memory_limit + state->memory_guard * 2);
+    return;
+  }
+#endif
+  free(state->memory_buffer);
+}
+
+/**
+ * @brief Grow a growable tape so that a cell becomes accessible.
+ * @param state The state of IBF.
+ * @param index The index of the cell.
+ * @return True if the cell is accessible, false if it is beyond the limit.
+ */
+bool brainfuck_tape_grow(struct brainfuck_state *state, size_t index) {
+  if (state->tape != BRAINFUCK_TAPE_GROW || index >= state->memory_limit) {
+    return false;
+  }
+  size_t size = state->memory_size * 2 > index ? state->memory_size * 2
+                                               : index + 1;
+  size = (size + BRAINFUCK_GROW_CHUNK_SIZE - 1) / BRAINFUCK_GROW_CHUNK_SIZE *
+         BRAINFUCK_GROW_CHUNK_SIZE;
+  if (size > state->memory_limit) {
+    size = state->memory_limit;
+  }
+#if defined(BRAINFUCK_HAVE_MMAP)
+  if (state->memory_mapped) {
+    if (mprotect(state->memory_buffer, size, PROT_READ | PROT_WRITE) != 0) {
+      return false;
+    }
+    state->memory_size = size;
+    return true;
+  }
+#endif
+  uint8_t *memory_buffer = realloc(state->memory_buffer, size);
+  if (memory_buffer == NULL) {
+    return false;
+  }
+  memset(memory_buffer + state->memory_size, 0, size - state->memory_size);
+  state->memory_buffer = memory_buffer;
+  state->memory_size = size;
+  return true;
+}
+
+/**
+ * @brief Create a new state of IBF.
+ * @param options The options of IBF, which choose the tape.
+ * @return The new state of IBF, or NULL if it or its tape cannot be
+ * allocated.
+ */
+struct brainfuck_state *brainfuck_state_new(
+    const struct brainfuck_options *options) {
+  struct brainfuck_state *state = malloc(sizeof(struct brainfuck_state));
+  if (state == NULL) {
+    return NULL;
+  }
+  if (!brainfuck_tape_allocate(state, options->tape, options->tape_size)) {
+    free(state);
+    return NULL;
+  }
+  state->memory_pointer = 0;
+  state->unmatched_depth = 0;
+  state->loop_stack = NULL;
+  state->loop_stack_capacity = 0;
+  state->loop_program.instructions = NULL;
+  state->loop_program.size = 0;
+  state->loop_program.capacity = 0;
+  state->loop_program.max_depth = 0;
+  state->loop_program.sources = NULL;
+  state->threaded_code = NULL;
+  state->threaded_capacity = 0;
+  state->fuel = 0;
+  state->steps = UINT64_MAX;
+  state->deadline = 0;
+  state->resume_pointer = 0;
+  state->suspended = BRAINFUCK_SUSPEND_NONE;
+  state->input = (struct brainfuck_buffer){NULL, 0, 0, 0};
+  state->input_ended = false;
+  state->output = (struct brainfuck_buffer){NULL, 0, 0, 0};
+  state->output_pending = 0;
+  state->quiet = false;
+  memset(&state->stats, 0, sizeof(state->stats));
+  return state;
+}
+
+/**
+ * @brief Make room on the loop stack of the state for loops nested `depth`
+ * deep. The stack is kept between compilations, so it only grows.
+ * @param state The state of IBF.
+ * @param depth The number of loops the stack must hold.
+ * @return The loop stack, or NULL if it cannot be allocated.
+ */
+size_t *brainfuck_state_reserve_loop_stack(struct brainfuck_state *state,
+                                           size_t depth) {
+  if (state == NULL) {
+    return NULL;
+  }
+  if (depth > state->loop_stack_capacity) {
+    size_t *loop_stack = realloc(state->loop_stack, sizeof(size_t) * depth);
+    if (loop_stack == NULL) {
+      return NULL;
+    }
+    state->loop_stack = loop_stack;
+    state->loop_stack_capacity = depth;
+  }
+  return state->loop_stack;
+}
+
+/**
+ * @brief Make room in the state for the threaded handlers of a program of
+ * `size` instructions. Like the loop stack, it only grows.
+ * @param state The state of IBF.
+ * @param size The number of handlers.
+ * @return The threaded handlers, or NULL if they cannot be allocated.
+ */
+void **brainfuck_state_reserve_threaded(struct brainfuck_state *state,
+                                        size_t size) {
+  if (state == NULL) {
+    return NULL;
+  }
+  if (size > state->threaded_capacity) {
+    void **threaded_code = realloc(state->threaded_code, sizeof(void *) * size);
+    if (threaded_code == NULL) {
+      return NULL;
+    }
+    state->threaded_code = threaded_code;
+    state->threaded_capacity = size;
+  }
+  return state->threaded_code;
+}
+
+/**
+ * @brief Free the state of IBF.
+ * @param state The state of IBF.
+ */
+void brainfuck_state_free(struct brainfuck_state *state) {
+  if (state == NULL) {
+    return;
+  }
+  brainfuck_tape_free(state);
+  free(state->loop_stack);
+  free(state->loop_program.instructions);
+  free(state->loop_program.sources);
+  free(state->threaded_code);
+  free(state->input.bytes);
+  free(state->output.bytes);
+  free(state);
+}
+
+/**
+ * @brief Clear the counts of a profile for a new run.
+ * @param profile The profile of IBF.
+ */
+void brainfuck_profile_clear(struct brainfuck_profile *profile) {
+  if (profile->size > 0) {
+    memset(profile->counts, 0, sizeof(uint64_t) * profile->size);
+    memset(profile->follows, 0, sizeof(uint64_t) * profile->size);
+    memset(profile->chains, 0, sizeof(uint64_t) * profile->size);
+    memset(profile->times, 0, sizeof(uint64_t) * profile->size);
+  }
+  if (profile->cells_size > 0) {
+    memset(profile->cells, 0, sizeof(uint64_t) * profile->cells_size);
+  }
+  profile->loop = SIZE_MAX;
+  profile->entered = 0;
+}
+
+/**
+ * @brief Make room in a profile to count every instruction of a program.
+ * @param profile The profile of IBF.
+ * @param size The number of instructions of the program.
+ * @return True if the room is allocated successfully.
+ */
+bool brainfuck_profile_reserve(struct brainfuck_profile *profile,
+                               size_t size) {
+  if (size <= profile->size) {
+    return true;
+  }
+  uint64_t **arrays[] = {&profile->counts, &profile->follows,
+                         &profile->chains, &profile->times};
+  for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i += 1) {
+    uint64_t *array = realloc(*arrays[i], sizeof(uint64_t) * size);
+    if (array == NULL) {
+      return false;
+    }
+    memset(array + profile->size, 0,
+           sizeof(uint64_t) * (size - profile->size));
+    *arrays[i] = array;
+  }
+  profile->size = size;
+  return true;
+}
+
+/**
+ * @brief Count an access to a cell in a profile. A cell too far to count,
+ * at the end of a huge growable tape, is left out.
+ * @param profile The profile of IBF.
+ * @param index The index of the cell.
+ */
+void brainfuck_profile_touch(struct brainfuck_profile *profile,
+                             size_t index) {
+  if (index >= profile->cells_size) {
+    size_t size = profile->cells_size == 0 ? 1024 : profile->cells_size;
+    while (size <= index) {
+      size *= 2;
+    }
+    uint64_t *cells = realloc(profile->cells, sizeof(uint64_t) * size);
+    if (cells == NULL) {
+      return;
+    }
+    memset(cells + profile->cells_size, 0,
+           sizeof(uint64_t) * (size - profile->cells_size));
+    profile->cells = cells;
+    profile->cells_size = size;
+  }
+  profile->cells[index] += 1;
+}
+
+/**
+ * @brief Free a profile of IBF.
+ * @param profile The profile of IBF.
+ */
+void brainfuck_profile_free(struct brainfuck_profile *profile) {
+  if (profile == NULL) {
+    return;
+  }
+  free(profile->counts);
+  free(profile->follows);
+  free(profile->chains);
+  free(profile->times);
+  free(profile->cells);
+  free(profile);
+}
+
+/**
+ * @brief Free the native code a context keeps for the JIT engine.
+ * @param cache The native code, or NULL.
+ */
+void brainfuck_jit_cache_free(struct brainfuck_jit_cache *cache) {
+  if (cache == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < BRAINFUCK_JIT_CACHE_SIZE; i += 1) {
+    struct brainfuck_jit_native *native = &cache->natives[i];
+#if defined(BRAINFUCK_HAVE_MMAP)
+    if (native->region != NULL) {
+      munmap(native->region, native->length);
+    }
+#endif
+    free(native->instructions);
+    free(native->entries);
+  }
+  free(cache);
+}
+
+/**
+ * @brief Create a new context of IBF.
+ * @param input_handler The input handler of IBF.
+ * @param output_handler The output handler of IBF.
+ * @param user_data The user data passed to both handlers.
+ * @param options The options of IBF.
+ * @return The new context of IBF, or NULL if it or its tape cannot be
+ * allocated.
+ */
+struct brainfuck_context *brainfuck_context_new(
+    brainfuck_input_handler input_handler,
+    brainfuck_output_handler output_handler, void *user_data,
+    const struct brainfuck_options *options) {
+  struct brainfuck_context *context = malloc(sizeof(struct brainfuck_context));
+  if (context == NULL) {
+    return NULL;
+  }
+  context->state = brainfuck_state_new(options);
+  if (context->state == NULL) {
+    free(context);
+    return NULL;
+  }
+  context->output_handler = output_handler;
+  context->input_handler = input_handler;
+  context->user_data = user_data;
+  context->options = *options;
+  context->profile = NULL;
+  context->jit = NULL;
+  if (options->engine == BRAINFUCK_ENGINE_PROFILE) {
+    context->profile = calloc(1, sizeof(struct brainfuck_profile));
+    if (context->profile == NULL) {
+      brainfuck_context_free(context);
+      return NULL;
+    }
+    context->profile->loop = SIZE_MAX;
+  }
+  brainfuck_context_budget(context, options->max_steps, options->timeout);
+  return context;
+}
+
+/**
+ * @brief Free the context of IBF.
+ * @param context The context of IBF.
+ */
+void brainfuck_context_free(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return;
+  }
+  brainfuck_state_free(context->state);
+  brainfuck_profile_free(context->profile);
+  brainfuck_jit_cache_free(context->jit);
+  free(context);
+}
+
+/**
+ * @brief Take note of the cells a context uses, up to the last one it points
+ * at or that holds a value. It is looked up here rather than tracked as the
+ * program runs.
+ * @param state The state of IBF.
+ */
+void brainfuck_stats_extent(struct brainfuck_state *state) {
+  size_t extent = state->memory_size;
+  while (extent > 0 && state->memory_buffer[extent - 1] == 0) {
+    extent -= 1;
+  }
+  if (state->memory_pointer >= extent) {
+    extent = state->memory_pointer + 1;
+  }
+  if (extent > state->stats.tape_extent) {
+    state->stats.tape_extent = extent;
+  }
+}
+
+/**
+ * @brief Clear every cell of the tape. A large mapped tape gives its pages
+ * back instead, so that they read as zero when they are touched again.
+ * @param state The state of IBF.
+ */
+void brainfuck_tape_clear(struct brainfuck_state *state) {
+#if defined(BRAINFUCK_HAVE_MMAP)
+  if (state->memory_mapped && state->memory_size > BRAINFUCK_GROW_CHUNK_SIZE &&
+      madvise(state->memory_buffer, state->memory_size, MADV_DONTNEED) == 0) {
+    return;
+  }
+#endif
+  memset(state->memory_buffer, 0, state->memory_size);
+}
+
+/**
+ * @brief Reset a context to a clear tape, no open loop and no input or
+ * output left, as if it were new. Its tape, loop stack, compiled buffers
+ * and native code are kept for the next run.
+ * @param context The context of IBF.
+ */
+void brainfuck_context_reset(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return;
+  }
+  brainfuck_stats_extent(context->state);
+  brainfuck_tape_clear(context->state);
+  context->state->memory_pointer = 0;
+  context->state->unmatched_depth = 0;
+  context->state->loop_program.size = 0;
+  context->state->resume_pointer = 0;
+  context->state->suspended = BRAINFUCK_SUSPEND_NONE;
+  context->state->input.begin = 0;
+  context->state->input.end = 0;
+  context->state->input_ended = false;
+  context->state->output.end = 0;
+  context->state->output_pending = 0;
+  if (context->profile != NULL) {
+    brainfuck_profile_clear(context->profile);
+  }
+  brainfuck_context_budget(context, context->options.max_steps,
+                           context->options.timeout);
+}
+
+/**
+ * @brief Get the time of a monotonic clock.
+ * @return The time in nanoseconds.
+ */
+uint64_t brainfuck_clock() {
+  struct timespec now;
+#if defined(BRAINFUCK_HAVE_MMAP)
+  clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+  timespec_get(&now, TIME_UTC);
+#endif
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Give a context the budget of its next run, or of the next slice of
+ * a suspended run. Loop iterations are counted where a loop jumps back, and
+ * the time is checked every `BRAINFUCK_BUDGET_SLICE` of them.
+ * @param context The context of IBF.
+ * @param steps The loop iterations of the budget, 0 for no limit.
+ * @param timeout The milliseconds of the budget from now, 0 for no limit.
+ */
+void brainfuck_context_budget(struct brainfuck_context *context,
+                              uint64_t steps, uint64_t timeout) {
+  if (context == NULL) {
+    return;
+  }
+  struct brainfuck_state *state = context->state;
+  /* Fuel left over from the last budget was never spent. */
+  state->stats.loop_iterations -= state->fuel;
+  state->fuel = 0;
+  /* The iteration that spends the last of the fuel asks for more before it
+   * jumps back, so the budget keeps one more for it. */
+  state->steps = steps == 0 || steps == UINT64_MAX ? UINT64_MAX : steps + 1;
+  state->deadline = 0;
+  if (timeout != 0) {
+    uint64_t now = brainfuck_clock();
+    state->deadline =
+        timeout < (UINT64_MAX - now) / 1000000 ? now + timeout * 1000000
+                                               : UINT64_MAX;
+  }
+}
+
+/**
+ * @brief Refill the fuel of a run from its budget once the fuel runs out.
+ * With a deadline, the fuel lasts a slice, so that the time is checked now
+ * and then. Without one, the whole budget is fuel.
+ * @param state The state of IBF.
+ * @return False if the budget is spent, marking the run as suspended. The
+ * engine then saves where it resumes.
+ */
+bool brainfuck_budget_refill(struct brainfuck_state *state) {
+  if (state->deadline != 0 && brainfuck_clock() >= state->deadline) {
+    state->suspended = BRAINFUCK_SUSPEND_TIMEOUT;
+    return false;
+  }
+  if (state->steps == 0) {
+    state->suspended = BRAINFUCK_SUSPEND_STEPS;
+    return false;
+  }
+  uint64_t grant = state->steps;
+  if (state->deadline != 0 && grant > BRAINFUCK_BUDGET_SLICE) {
+    grant = BRAINFUCK_BUDGET_SLICE;
+  }
+  state->steps -= grant;
+  state->fuel = grant;
+  state->stats.loop_iterations += grant;
+  return true;
+}
+
+/**
+ * @brief Feed input to a context without an input handler, after the input
+ * it has not read yet. A run suspended for input is then resumed with
+ * `brainfuck_program_resume`.
+ * @param context The context of IBF.
+ * @param bytes The bytes to feed, which are copied.
+ * @param length The number of bytes to feed.
+ * @param end Whether the input ends after these bytes, so that `,` then
+ * handles the end of the input instead of suspending the run.
+ * @return True if the bytes are fed, false if they cannot be allocated.
+ */
+bool brainfuck_context_feed(struct brainfuck_context *context,
+                            const uint8_t *bytes, size_t length, bool end) {
+  if (context == NULL) {
+    return false;
+  }
+  struct brainfuck_buffer *input = &context->state->input;
+  if (input->end + length > input->capacity) {
+    /* Move the unread input to the front before growing the buffer. */
+    size_t unread = input->end - input->begin;
+    if (input->begin > 0) {
+      memmove(input->bytes, input->bytes + input->begin, unread);
+      input->begin = 0;
+      input->end = unread;
+    }
+    if (unread + length > input->capacity) {
+      size_t capacity = input->capacity * 2;
+      if (capacity < unread + length) {
+        capacity = unread + length;
+      }
+      uint8_t *grown = realloc(input->bytes, capacity);
+      if (grown == NULL) {
+        return false;
+      }
+      input->bytes = grown;
+      input->capacity = capacity;
+    }
+  }
+  if (length > 0) {
+    memcpy(input->bytes + input->end, bytes, length);
+    input->end += length;
+  }
+  if (end) {
+    context->state->input_ended = true;
+  }
+  return true;
+}
+
+/**
+ * @brief Take the output of a context without an output handler, which
+ * empties its buffer. A run suspended for output is then resumed with
+ * `brainfuck_program_resume`.
+ * @param context The context of IBF.
+ * @param length Set to the number of bytes taken.
+ * @return The bytes taken, valid until the context runs again.
+ */
+const uint8_t *brainfuck_context_output(struct brainfuck_context *context,
+                                        size_t *length) {
+  if (context == NULL) {
+    *length = 0;
+    return NULL;
+  }
+  *length = context->state->output.end;
+  context->state->output.end = 0;
+  return context->state->output.bytes;
+}
+
+/**
+ * @brief Get the statistics of a context. They go on counting across runs
+ * and resets, for the whole life of the context.
+ * @param context The context of IBF.
+ * @param stats Set to the statistics.
+ */
+void brainfuck_context_stats(struct brainfuck_context *context,
+                             struct brainfuck_stats *stats) {
+  if (context == NULL || stats == NULL) {
+    return;
+  }
+  struct brainfuck_state *state = context->state;
+  brainfuck_stats_extent(state);
+  *stats = state->stats;
+  /* The fuel still left is not spent yet. */
+  stats->loop_iterations -= state->fuel;
+}
+
+/**
+ * @brief Create a new pool of contexts of IBF.
+ * @param options The options of every context of the pool.
+ * @param capacity The number of idle contexts the pool keeps at most.
+ * @return The new pool of IBF, or NULL if it cannot be allocated.
+ */
+struct brainfuck_pool *brainfuck_pool_new(
+    const struct brainfuck_options *options, size_t capacity) {
+  struct brainfuck_pool *pool = malloc(sizeof(struct brainfuck_pool));
+  if (pool == NULL) {
+    return NULL;
+  }
+  pool->options = *options;
+  pool->contexts = malloc(sizeof(struct brainfuck_context *) *
+                          (capacity == 0 ? 1 : capacity));
+  if (pool->contexts == NULL) {
+    free(pool);
+    return NULL;
+  }
+  pool->size = 0;
+  pool->capacity = capacity;
+  return pool;
+}
+
+/**
+ * @brief Take a context from the pool, or create one if none is idle.
+ * @param pool The pool of IBF.
+ * @param input_handler The input handler of the context.
+ * @param output_handler The output handler of the context.
+ * @param user_data The user data passed to both handlers.
+ * @return The context, or NULL if the tape cannot be allocated.
+ */
+struct brainfuck_context *brainfuck_pool_acquire(
+    struct brainfuck_pool *pool, brainfuck_input_handler input_handler,
+    brainfuck_output_handler output_handler, void *user_data) {
+  if (pool->size == 0) {
+    return brainfuck_context_new(input_handler, output_handler, user_data,
+                                 &pool->options);
+  }
+  pool->size -= 1;
+  struct brainfuck_context *context = pool->contexts[pool->size];
+  context->input_handler = input_handler;
+  context->output_handler = output_handler;
+  context->user_data = user_data;
+  /* The time of the budget starts with the run, not with the release. */
+  brainfuck_context_budget(context, pool->options.max_steps,
+                           pool->options.timeout);
+  return context;
+}
+
+/**
+ * @brief Give a context back to the pool, which resets it for the next run,
+ * or frees it if the pool is full.
+ * @param pool The pool of IBF.
+ * @param context The context taken from the pool.
+ */
+void brainfuck_pool_release(struct brainfuck_pool *pool,
+                            struct brainfuck_context *context) {
+  if (context == NULL) {
+    return;
+  }
+  if (pool->size == pool->capacity) {
+    brainfuck_context_free(context);
+    return;
+  }
+  brainfuck_context_reset(context);
+  pool->contexts[pool->size] = context;
+  pool->size += 1;
+}
+
+/**
+ * @brief Free the pool of IBF and its idle contexts. Contexts still taken
+ * from it are freed with `brainfuck_context_free`.
+ * @param pool The pool of IBF.
+ */
+void brainfuck_pool_free(struct brainfuck_pool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < pool->size; i += 1) {
+    brainfuck_context_free(pool->contexts[i]);
+  }
+  free(pool->contexts);
+  free(pool);
+}
+
+void print_error_unmatched_loop_end() {
+  fprintf(stderr, "SyntaxError: unmatched ']'.\n");
+}
+
+void print_error_unmatched_loop_start() {
+  fprintf(stderr, "SyntaxError: unmatched '['.\n");
+}
+
+void print_error_unmatched_loop_end_at(size_t offset) {
+  fprintf(stderr, "SyntaxError: unmatched ']' at byte %zu.\n", offset);
+}
+
+void print_error_unmatched_loop_start_at(size_t offset) {
+  fprintf(stderr, "SyntaxError: unmatched '[' at byte %zu.\n", offset);
+}
+
+void print_error_max_loop_depth() {
+  fprintf(stderr, "LoopError: maximum loop depth exceeded.\n");
+}
+
+void print_error_max_program_size() {
+  fprintf(stderr, "CompileError: maximum program size exceeded.\n");
+}
+
+/**
+ * @brief Report that the memory pointer ran off the tape, unless the state
+ * is quiet.
+ * @param state The state of IBF.
+ */
+void print_error_tape_out_of_range(const struct brainfuck_state *state) {
+  if (!state->quiet) {
+    fprintf(stderr, "TapeError: memory pointer out of range.\n");
+  }
+}
+
+/**
+ * @brief Execute the plus instruction `+` of brainfuck.
+ * @param context The context of IBF.
+ */
+void brainfuck_execute_plus(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return;
+  }
+  context->state->memory_buffer[context->state->memory_pointer] += 1;
+}
+
+/**
+ * @brief Execute the minus instruction `-` of brainfuck.
+ * @param context The context of IBF.
+ */
+void brainfuck_execute_minus(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return;
+  }
+  context->state->memory_buffer[context->state->memory_pointer] -= 1;
+}
+
+/**
+ * @brief Find the cell at an offset to the memory pointer that falls outside
+ * the accessible memory, by wrapping around a fixed tape or by growing a
+ * growable one.
+ * @param state The state of IBF.
+ * @param pointer The memory pointer.
+ * @param offset The offset of the cell.
+ * @param index Set to the index of the cell.
+ * @return True if the cell is found, false after reporting a tape error.
+ */
+bool brainfuck_tape_locate(struct brainfuck_state *state, size_t pointer,
+                           int32_t offset, size_t *index) {
+  int64_t target = (int64_t)pointer + offset;
+  if (state->tape == BRAINFUCK_TAPE_FIXED) {
+    target %= (int64_t)state->memory_size;
+    *index = (size_t)(target < 0 ? target + (int64_t)state->memory_size
+                                 : target);
+    return true;
+  }
+  if (target < 0 || !brainfuck_tape_grow(state, (size_t)target)) {
+    print_error_tape_out_of_range(state);
+    return false;
+  }
+  *index = (size_t)target;
+  return true;
+}
+
+/**
+ * @brief Get the index of the cell at an offset to the memory pointer.
+ * @param state The state of IBF.
+ * @param pointer The memory pointer.
+ * @param offset The offset of the cell.
+ * @param index Set to the index of the cell, and left as it is on errors.
+ * @return True if the cell is found, false after reporting a tape error.
+ */
+bool brainfuck_memory_index(struct brainfuck_state *state, size_t pointer,
+                            int32_t offset, size_t *index) {
+  size_t target = pointer + (size_t)offset;
+  if (target < state->memory_size) {
+    *index = target;
+    return true;
+  }
+  return brainfuck_tape_locate(state, pointer, offset, index);
+}
+
+/**
+ * @brief Execute the previous instruction `<` of brainfuck.
+ * @param context The context of IBF.
+ * @return True if the instruction is executed successfully.
+ */
+bool brainfuck_execute_previous(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_memory_index(context->state,
+                                context->state->memory_pointer, -1,
+                                &context->state->memory_pointer);
+}
+
+/**
+ * @brief Execute the next instruction `>` of brainfuck.
+ * @param context The context of IBF.
+ * @return True if the instruction is executed successfully.
+ */
+bool brainfuck_execute_next(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_memory_index(context->state,
+                                context->state->memory_pointer, 1,
+                                &context->state->memory_pointer);
+}
+
+/**
+ * @brief Handle the end of the input as the options say.
+ * @param context The context of IBF.
+ * @param cell The cell being read into.
+ * @return False if the end of the input stops the program.
+ */
+bool brainfuck_input_end(struct brainfuck_context *context, uint8_t *cell) {
+  switch (context->options.eof) {
+    case BRAINFUCK_EOF_UNCHANGED:
+      break;
+    case BRAINFUCK_EOF_ZERO:
+      *cell = 0;
+      break;
+    case BRAINFUCK_EOF_MAX:
+      *cell = UINT8_MAX;
+      break;
+    case BRAINFUCK_EOF_EXIT:
+    default:
+      /* Stop only this context, which may share the process with others. */
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Read a byte from the input handler into a cell, or from the input
+ * fed to a context without one, and handle the end of the input as the
+ * options say.
+ * @param context The context of IBF.
+ * @param cell The cell to read into.
+ * @return False if the end of the input stops the program, or if the run is
+ * suspended until more input is fed. The engine then saves where it
+ * resumes, which is this `,` again.
+ */
+bool brainfuck_input(struct brainfuck_context *context, uint8_t *cell) {
+  struct brainfuck_state *state = context->state;
+  if (context->input_handler != NULL) {
+    if (!context->input_handler(context->user_data, cell)) {
+      return brainfuck_input_end(context, cell);
+    }
+    state->stats.bytes_in += 1;
+    return true;
+  }
+  if (state->input.begin < state->input.end) {
+    *cell = state->input.bytes[state->input.begin];
+    state->input.begin += 1;
+    state->stats.bytes_in += 1;
+    return true;
+  }
+  if (!state->input_ended) {
+    state->suspended = BRAINFUCK_SUSPEND_INPUT;
+    return false;
+  }
+  return brainfuck_input_end(context, cell);
+}
+
+/**
+ * @brief Execute the input instruction `,` of brainfuck.
+ * @param context The context of IBF.
+ * @return False if the end of the input stops the program.
+ */
+bool brainfuck_execute_input(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_input(
+      context, &context->state->memory_buffer[context->state->memory_pointer]);
+}
+
+/**
+ * @brief Write a byte several times to the output buffer of a context
+ * without an output handler, as far as it has room.
+ * @param context The context of IBF.
+ * @param value The byte to write.
+ * @param count The number of times to write it, unless a suspended `.` is
+ * resumed, which writes what it has left.
+ * @return False if the buffer is full, suspending the run with the bytes
+ * left in `state->output_pending`, or if it cannot be allocated.
+ */
+bool brainfuck_output_buffered(struct brainfuck_context *context,
+                               uint8_t value, size_t count) {
+  struct brainfuck_state *state = context->state;
+  struct brainfuck_buffer *output = &state->output;
+  if (state->output_pending != 0) {
+    count = state->output_pending;
+    state->output_pending = 0;
+  }
+  if (output->bytes == NULL) {
+    output->bytes = malloc(BRAINFUCK_CONTEXT_OUTPUT_SIZE);
+    if (output->bytes == NULL) {
+      return false;
+    }
+    output->capacity = BRAINFUCK_CONTEXT_OUTPUT_SIZE;
+  }
+  size_t room = output->capacity - output->end;
+  size_t length = count < room ? count : room;
+  memset(output->bytes + output->end, value, length);
+  output->end += length;
+  state->stats.bytes_out += length;
+  if (length < count) {
+    state->output_pending = count - length;
+    state->suspended = BRAINFUCK_SUSPEND_OUTPUT;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Write a byte to the output handler several times, in batches, or
+ * to the output buffer of a context without one.
+ * @param context The context of IBF.
+ * @param value The byte to write.
+ * @param count The number of times to write it.
+ * @return False if the run is suspended until the output is taken. The
+ * engine then saves where it resumes, which is this `.` again.
+ */
+bool brainfuck_output_repeat(struct brainfuck_context *context, uint8_t value,
+                             size_t count) {
+  if (context->output_handler == NULL) {
+    return brainfuck_output_buffered(context, value, count);
+  }
+  context->state->stats.bytes_out += count;
+  if (count == 1) {
+    context->output_handler(context->user_data, &value, 1);
+    return true;
+  }
+  uint8_t batch[256];
+  memset(batch, value, count < sizeof(batch) ? count : sizeof(batch));
+  while (count > 0) {
+    size_t length = count < sizeof(batch) ? count : sizeof(batch);
+    context->output_handler(context->user_data, batch, length);
+    count -= length;
+  }
+  return true;
+}
+
+/**
+ * @brief Execute the output instruction `.` of brainfuck.
+ * @param context The context of IBF.
+ * @return False if the output buffer of a context without an output handler
+ * is full.
+ */
+bool brainfuck_execute_output(struct brainfuck_context *context) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_output_repeat(
+      context, context->state->memory_buffer[context->state->memory_pointer],
+      1);
+}
+
+/**
+ * @brief Execute a run of `+` and `-` instructions folded into one addition.
+ * @param context The context of IBF.
+ * @param value The value to add to the current cell.
+ */
+void brainfuck_execute_add(struct brainfuck_context *context, uint8_t value) {
+  if (context == NULL) {
+    return;
+  }
+  context->state->memory_buffer[context->state->memory_pointer] += value;
+}
+
+/**
+ * @brief Execute a run of `<` and `>` instructions folded into one move.
+ * @param context The context of IBF.
+ * @param distance The distance to move.
+ * @return True if the move is executed successfully.
+ */
+bool brainfuck_execute_move(struct brainfuck_context *context,
+                            int32_t distance) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_memory_index(context->state,
+                                context->state->memory_pointer, distance,
+                                &context->state->memory_pointer);
+}
+
+#if defined(BRAINFUCK_SCAN_WIDTH)
+#if defined(__ARM_NEON) && !defined(__AVX2__) && !defined(__SSE2__) && \
+    !defined(_M_X64)
+/**
+ * @brief Gather the top bit of every byte of a vector into a mask.
+ * @param bytes The bytes, each either all ones or all zeros.
+ * @return A mask with bit `i` set if byte `i` is set.
+ */
+uint64_t brainfuck_scan_movemask(uint8x16_t bytes) {
+  static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t bits = vandq_u8(bytes, vld1q_u8(weights));
+  return (uint64_t)vaddv_u8(vget_low_u8(bits)) |
+         ((uint64_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+#endif
+
+/**
+ * @brief Find the zero cells of a block of `BRAINFUCK_SCAN_WIDTH` cells.
+ * @param block The first cell of the block.
+ * @return A mask with bit `i` set if the cell `block[i]` is zero.
+ */
+uint64_t brainfuck_scan_zero_mask(const uint8_t *block) {
+#if defined(__AVX2__)
+  __m256i cells = _mm256_loadu_si256((const __m256i *)block);
+  return (uint32_t)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(cells, _mm256_setzero_si256()));
+#elif defined(__SSE2__) || defined(_M_X64)
+  __m128i cells = _mm_loadu_si128((const __m128i *)block);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(cells, _mm_setzero_si128()));
+#else
+  return brainfuck_scan_movemask(vceqq_u8(vld1q_u8(block), vdupq_n_u8(0)));
+#endif
+}
+
+/**
+ * @brief Find the brainfuck tokens of a block of `BRAINFUCK_SCAN_WIDTH`
+ * bytes of source.
+ * @param block The first byte of the block.
+ * @return A mask with bit `i` set if `block[i]` is one of the eight tokens.
+ */
+uint64_t brainfuck_scan_token_mask(const uint8_t *block) {
+  /* `+`, `,`, `-` and `.` are consecutive, and `<` and `>` only differ in
+   * the bit that is set to compare them at once. */
+#if defined(__AVX2__)
+  __m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+  __m256i arithmetic = _mm256_sub_epi8(bytes, _mm256_set1_epi8('+'));
+  __m256i tokens = _mm256_or_si256(
+      _mm256_or_si256(
+          _mm256_cmpeq_epi8(
+              _mm256_min_epu8(arithmetic, _mm256_set1_epi8(3)), arithmetic),
+          _mm256_cmpeq_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(2)),
+                            _mm256_set1_epi8('>'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('[')),
+                      _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(']'))));
+  return (uint32_t)_mm256_movemask_epi8(tokens);
+#elif defined(__SSE2__) || defined(_M_X64)
+  __m128i bytes = _mm_loadu_si128((const __m128i *)block);
+  __m128i arithmetic = _mm_sub_epi8(bytes, _mm_set1_epi8('+'));
+  __m128i tokens = _mm_or_si128(
+      _mm_or_si128(
+          _mm_cmpeq_epi8(_mm_min_epu8(arithmetic, _mm_set1_epi8(3)),
+                         arithmetic),
+          _mm_cmpeq_epi8(_mm_or_si128(bytes, _mm_set1_epi8(2)),
+                         _mm_set1_epi8('>'))),
+      _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('[')),
+                   _mm_cmpeq_epi8(bytes, _mm_set1_epi8(']'))));
+  return (uint32_t)_mm_movemask_epi8(tokens);
+#else
+  uint8x16_t bytes = vld1q_u8(block);
+  uint8x16_t tokens = vorrq_u8(
+      vorrq_u8(vcleq_u8(vsubq_u8(bytes, vdupq_n_u8('+')), vdupq_n_u8(3)),
+               vceqq_u8(vorrq_u8(bytes, vdupq_n_u8(2)), vdupq_n_u8('>'))),
+      vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('[')),
+               vceqq_u8(bytes, vdupq_n_u8(']'))));
+  return brainfuck_scan_movemask(tokens);
+#endif
+}
+#endif
+
+/**
+ * @brief Get the index of the lowest set bit of a nonzero mask.
+ */
+size_t brainfuck_scan_lowest_bit(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return index;
+#else
+  return (size_t)__builtin_ctzll(mask);
+#endif
+}
+
+/**
+ * @brief Get the index of the highest set bit of a nonzero mask.
+ */
+size_t brainfuck_scan_highest_bit(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, mask);
+  return index;
+#else
+  return 63 - (size_t)__builtin_clzll(mask);
+#endif
+}
+
+/**
+ * @brief Find the first zero cell among `begin`, `begin + stride`, ... that
+ * lies before `end`.
+ * @param memory The memory buffer.
+ * @param begin The index to start from.
+ * @param end The index to stop before.
+ * @param stride The distance between two visited cells.
+ * @return The index of the zero cell, or `end` if there is none.
+ */
+size_t brainfuck_scan_forward(const uint8_t *memory, size_t begin, size_t end,
+                              size_t stride) {
+  if (stride == 1) {
+    const uint8_t *found = memchr(memory + begin, 0, end - begin);
+    return found == NULL ? end : (size_t)(found - memory);
+  }
+  size_t index = begin;
+#if defined(BRAINFUCK_SCAN_WIDTH)
+  if (stride <= BRAINFUCK_SCAN_WIDTH) {
+    /* Bits at every visited cell of a block whose first cell is visited. */
+    uint64_t pattern = 0;
+    for (size_t i = 0; i < BRAINFUCK_SCAN_WIDTH; i += stride) {
+      pattern |= (uint64_t)1 << i;
+    }
+    size_t block = begin;
+    size_t phase = 0; /* The first visited cell of the block. */
+    while (block + BRAINFUCK_SCAN_WIDTH <= end) {
+      uint64_t mask = brainfuck_scan_zero_mask(memory + block) &
+                      (pattern << phase);
+      if (mask != 0) {
+        return block + brainfuck_scan_lowest_bit(mask);
+      }
+      phase = (stride - (BRAINFUCK_SCAN_WIDTH - phase) % stride) % stride;
+      block += BRAINFUCK_SCAN_WIDTH;
+    }
+    index = block + phase;
+  }
+#endif
+  for (; index < end; index += stride) {
+    if (memory[index] == 0) {
+      return index;
+    }
+  }
+  return end;
+}
+
+/**
+ * @brief Find the first zero cell among `begin`, `begin - stride`, ... that
+ * is not below the first cell.
+ * @param memory The memory buffer.
+ * @param begin The index to start from.
+ * @param stride The distance between two visited cells.
+ * @return The index of the zero cell, or `SIZE_MAX` if there is none.
+ */
+size_t brainfuck_scan_backward(const uint8_t *memory, size_t begin,
+                               size_t stride) {
+  size_t index = begin;
+#if defined(BRAINFUCK_SCAN_WIDTH)
+  if (stride <= BRAINFUCK_SCAN_WIDTH) {
+    /* Bits at every visited cell of a block whose last cell is visited. */
+    uint64_t pattern = 0;
+    for (size_t i = 0; i < BRAINFUCK_SCAN_WIDTH; i += stride) {
+      pattern |= (uint64_t)1 << (BRAINFUCK_SCAN_WIDTH - 1 - i);
+    }
+    size_t top = begin + 1; /* One past the last cell of the block. */
+    size_t phase = 0;       /* The distance of the last visited cell. */
+    while (top >= BRAINFUCK_SCAN_WIDTH) {
+      size_t block = top - BRAINFUCK_SCAN_WIDTH;
+      uint64_t mask = brainfuck_scan_zero_mask(memory + block) &
+                      (pattern >> phase);
+      if (mask != 0) {
+        return block + brainfuck_scan_highest_bit(mask);
+      }
+      phase = (stride - (BRAINFUCK_SCAN_WIDTH - phase) % stride) % stride;
+      top = block;
+    }
+    if (top <= phase) {
+      return SIZE_MAX;
+    }
+    index = top - 1 - phase;
+  }
+#endif
+  while (true) {
+    if (memory[index] == 0) {
+      return index;
+    }
+    if (index < stride) {
+      return SIZE_MAX;
+    }
+    index -= stride;
+  }
+}
+
+/**
+ * @brief Run a scan loop such as `[>]` or `[<<]`, which moves until it
+ * reaches a zero cell. Every pass over the tape spends a loop iteration of
+ * the budget, since a tape without a zero cell is scanned forever.
+ * @param state The state of IBF.
+ * @param pointer The memory pointer to start from, set to the zero cell, or
+ * to a cell to resume the scan from once the budget is spent.
+ * @param stride The distance of every move.
+ * @return True if the scan is run successfully, false after reporting a tape
+ * error or once the budget is spent.
+ */
+bool brainfuck_memory_scan(struct brainfuck_state *state, size_t *pointer,
+                           int32_t stride) {
+  size_t index = *pointer;
+  bool success = true;
+  while (success && state->memory_buffer[index] != 0) {
+    const uint8_t *memory = state->memory_buffer;
+    size_t size = state->memory_size;
+    if (stride > 0) {
+      size_t found =
+          brainfuck_scan_forward(memory, index, size, (size_t)stride);
+      if (found != size) {
+        index = found;
+        break;
+      }
+      /* Go to the last visited cell, then move past the end as a move does. */
+      index += (size - 1 - index) / (size_t)stride * (size_t)stride;
+    } else {
+      size_t found = brainfuck_scan_backward(memory, index, (size_t)-stride);
+      if (found != SIZE_MAX) {
+        index = found;
+        break;
+      }
+      index %= (size_t)-stride;
+    }
+    state->fuel -= 1;
+    if (state->fuel == 0 && !brainfuck_budget_refill(state)) {
+      success = false;
+      break;
+    }
+    success = brainfuck_memory_index(state, index, stride, &index);
+  }
+  *pointer = index;
+  return success;
+}
+
+/**
+ * @brief Execute a scan loop such as `[>]` or `[<<]`.
+ * @param context The context of IBF.
+ * @param stride The distance of every move.
+ * @return True if the scan is executed successfully.
+ */
+bool brainfuck_execute_scan(struct brainfuck_context *context,
+                            int32_t stride) {
+  if (context == NULL) {
+    return false;
+  }
+  return brainfuck_memory_scan(context->state,
+                               &context->state->memory_pointer, stride);
+}
+
+/**
+ * @brief Create a new empty program of IBF.
+ * @return The new program of IBF, or NULL if it cannot be allocated.
+ */
+struct brainfuck_program *brainfuck_program_new() {
+  struct brainfuck_program *program = malloc(sizeof(struct brainfuck_program));
+  if (program == NULL) {
+    return NULL;
+  }
+  program->instructions = NULL;
+  program->size = 0;
+  program->capacity = 0;
+  program->max_depth = 0;
+  program->sources = NULL;
+  return program;
+}
+
+/**
+ * @brief Free the program of IBF.
+ * @param program The program of IBF.
+ */
+void brainfuck_program_free(struct brainfuck_program *program) {
+  if (program == NULL) {
+    return;
+  }
+  free(program->instructions);
+  free(program->sources);
+  free(program);
+}
+
+/**
+ * @brief Make room for more instructions in a program, and for their source
+ * offsets if they are tracked.
+ * @param program The program of IBF.
+ * @param capacity The number of instructions the program must hold.
+ * @return True if the room is allocated successfully.
+ */
+bool brainfuck_program_reserve(struct brainfuck_program *program,
+                               size_t capacity) {
+  if (capacity <= program->capacity) {
+    return true;
+  }
+  struct brainfuck_instruction *instructions = realloc(
+      program->instructions, sizeof(struct brainfuck_instruction) * capacity);
+  if (instructions == NULL) {
+    return false;
+  }
+  program->instructions = instructions;
+  if (program->sources != NULL) {
+    size_t *sources = realloc(program->sources, sizeof(size_t) * capacity);
+    if (sources == NULL) {
+      return false;
+    }
+    program->sources = sources;
+  }
+  program->capacity = capacity;
+  return true;
+}
+
+/**
+ * @brief Track the source offset of every instruction compiled into a
+ * program from now on, so that a profile can point back at the source.
+ * @param program The program of IBF.
+ * @return True if the offsets can be tracked.
+ */
+bool brainfuck_program_track(struct brainfuck_program *program) {
+  if (program == NULL) {
+    return false;
+  }
+  if (program->sources != NULL) {
+    return true;
+  }
+  if (!brainfuck_program_reserve(program, 64)) {
+    return false;
+  }
+  program->sources = malloc(sizeof(size_t) * program->capacity);
+  return program->sources != NULL;
+}
+
+/**
+ * @brief Append an instruction to the program.
+ * @param program The program of IBF.
+ * @param opcode The opcode of the instruction.
+ * @param offset The cell offset of the instruction.
+ * @param argument The argument of the instruction.
+ * @return True if the instruction is appended successfully.
+ */
+bool brainfuck_program_emit(struct brainfuck_program *program, uint8_t opcode,
+                            int32_t offset, int32_t argument) {
+  if (program == NULL) {
+    return false;
+  }
+  if (program->size == BRAINFUCK_MAX_PROGRAM_SIZE) {
+    print_error_max_program_size();
+    return false;
+  }
+  if (program->size == program->capacity &&
+      !brainfuck_program_reserve(
+          program, program->capacity == 0 ? 64 : program->capacity * 2)) {
+    return false;
+  }
+  program->instructions[program->size].opcode = opcode;
+  program->instructions[program->size].offset = offset;
+  program->instructions[program->size].argument = argument;
+  program->size += 1;
+  return true;
+}
+
+/**
+ * @brief Append an addition, a move or an output to the program, folding it
+ * into the previous instruction if that has the same opcode.
+ * @param program The program of IBF.
+ * @param opcode `BRAINFUCK_OP_ADD`, `BRAINFUCK_OP_MOVE` or
+ * `BRAINFUCK_OP_OUTPUT`.
+ * @param argument The amount to add, the distance to move or the number of
+ * writes.
+ * @return True if the instruction is appended successfully.
+ */
+bool brainfuck_program_emit_folded(struct brainfuck_program *program,
+                                   uint8_t opcode, int32_t argument) {
+  if (program == NULL) {
+    return false;
+  }
+  struct brainfuck_instruction *last =
+      program->size == 0 ? NULL : &program->instructions[program->size - 1];
+  /* Moves are not wrapped here since the tape is not known yet, so a very
+   * long run is split before it overflows. */
+  if (last == NULL || last->opcode != opcode ||
+      (opcode == BRAINFUCK_OP_MOVE &&
+       (last->argument >= BRAINFUCK_MAX_DISTANCE ||
+        last->argument <= -BRAINFUCK_MAX_DISTANCE)) ||
+      (opcode == BRAINFUCK_OP_OUTPUT && last->argument == INT32_MAX)) {
+    return brainfuck_program_emit(program, opcode, 0, argument);
+  }
+  if (opcode == BRAINFUCK_OP_ADD) {
+    last->argument = (last->argument + argument) & UINT8_MAX;
+  } else {
+    last->argument += argument;
+  }
+  /* Drop runs that cancel out, such as `+-` or `><`. */
+  if (last->argument == 0) {
+    program->size -= 1;
+  }
+  return true;
+}
+
+/**
+ * @brief Compile one token of brainfuck code onto the end of a program,
+ * folding it into the previous instruction where possible and patching the
+ * matching loop start at each `]`.
+ * @param state The state whose loop stack holds the unmatched loops.
+ * @param program The program to compile into.
+ * @param token The token to compile, anything else is ignored.
+ * @param depth The number of unmatched loops, updated by `[` and `]`.
+ * @return True if the token is compiled successfully, false otherwise.
+ */
+bool brainfuck_compile_token(struct brainfuck_state *state,
+                             struct brainfuck_program *program, char token,
+                             size_t *depth) {
+  switch (token) {
+    case BRAINFUCK_TOKEN_PLUS:
+      return brainfuck_program_emit_folded(program, BRAINFUCK_OP_ADD, 1);
+    case BRAINFUCK_TOKEN_MINUS:
+      return brainfuck_program_emit_folded(program, BRAINFUCK_OP_ADD,
+                                           UINT8_MAX);
+    case BRAINFUCK_TOKEN_PREVIOUS:
+      return brainfuck_program_emit_folded(program, BRAINFUCK_OP_MOVE, -1);
+    case BRAINFUCK_TOKEN_NEXT:
+      return brainfuck_program_emit_folded(program, BRAINFUCK_OP_MOVE, 1);
+    case BRAINFUCK_TOKEN_INPUT:
+      return brainfuck_program_emit(program, BRAINFUCK_OP_INPUT, 0, 0);
+    case BRAINFUCK_TOKEN_OUTPUT:
+      return brainfuck_program_emit_folded(program, BRAINFUCK_OP_OUTPUT, 1);
+    case BRAINFUCK_TOKEN_LOOP_START:
+      if (*depth == BRAINFUCK_MAX_LOOP_DEPTH) {
+        print_error_max_loop_depth();
+        return false;
+      }
+      if (*depth == state->loop_stack_capacity) {
+        size_t capacity = *depth == 0 ? 16 : *depth * 2;
+        if (brainfuck_state_reserve_loop_stack(
+                state, capacity < BRAINFUCK_MAX_LOOP_DEPTH
+                           ? capacity
+                           : BRAINFUCK_MAX_LOOP_DEPTH) == NULL) {
+          return false;
+        }
+      }
+      state->loop_stack[*depth] = program->size;
+      *depth += 1;
+      if (*depth > program->max_depth) {
+        program->max_depth = *depth;
+      }
+      if (*depth > state->stats.max_loop_depth) {
+        state->stats.max_loop_depth = *depth;
+      }
+      state->stats.loops_compiled += 1;
+      /* The argument is patched once the matching end is found. */
+      return brainfuck_program_emit(program, BRAINFUCK_OP_LOOP_START, 0, 0);
+    case BRAINFUCK_TOKEN_LOOP_END: {
+      if (*depth == 0) {
+        print_error_unmatched_loop_end();
+        return false;
+      }
+      *depth -= 1;
+      size_t start = state->loop_stack[*depth];
+      program->instructions[start].argument = (int32_t)program->size;
+      return brainfuck_program_emit(program, BRAINFUCK_OP_LOOP_END, 0,
+                                    (int32_t)start);
+    }
+    default:
+      return true;
+  }
+}
+
+/**
+ * @brief Find the brainfuck tokens among up to 64 bytes of source, a vector
+ * at a time while the bytes fill one.
+ * @param src The bytes of source.
+ * @param length The number of bytes, at most 64.
+ * @return A mask with bit `i` set if `src[i]` is one of the eight tokens.
+ */
+uint64_t brainfuck_compile_tokens(const char *src, size_t length) {
+  uint64_t tokens = 0;
+  size_t i = 0;
+#if defined(BRAINFUCK_SCAN_WIDTH)
+  for (; i + BRAINFUCK_SCAN_WIDTH <= length; i += BRAINFUCK_SCAN_WIDTH) {
+    tokens |= brainfuck_scan_token_mask((const uint8_t *)src + i) << i;
+  }
+#endif
+  for (; i < length; i += 1) {
+    switch (src[i]) {
+      case BRAINFUCK_TOKEN_PLUS:
+      case BRAINFUCK_TOKEN_MINUS:
+      case BRAINFUCK_TOKEN_PREVIOUS:
+      case BRAINFUCK_TOKEN_NEXT:
+      case BRAINFUCK_TOKEN_OUTPUT:
+      case BRAINFUCK_TOKEN_INPUT:
+      case BRAINFUCK_TOKEN_LOOP_START:
+      case BRAINFUCK_TOKEN_LOOP_END:
+        tokens |= (uint64_t)1 << i;
+        break;
+      default:
+        break;
+    }
+  }
+  return tokens;
+}
+
+/**
+ * @brief Compile brainfuck code into a program, folding runs of `+`, `-`,
+ * `<` and `>` and resolving every loop to the index of its matching
+ * instruction. The code is checked as it is compiled, so that a program
+ * with an unmatched loop is rejected, with the offset of the loop, before
+ * any of it runs.
+ * @param state The state whose loop stack is used for unmatched loops.
+ * @param program The program to compile into, its old content is discarded.
+ * @param src The brainfuck code to compile.
+ * @param length The length of the brainfuck code.
+ * @return True if the code is compiled successfully, false otherwise.
+ */
+bool brainfuck_compile(struct brainfuck_state *state,
+                       struct brainfuck_program *program, const char *src,
+                       size_t length) {
+  if (state == NULL || program == NULL || src == NULL) {
+    return false;
+  }
+  program->size = 0;
+  program->max_depth = 0;
+  uint64_t started = brainfuck_clock();
+  size_t depth = 0;
+  bool success = true;
+  /* Comments are skipped 64 bytes at a time, and only tokens are visited. */
+  for (size_t block = 0; success && block < length; block += 64) {
+    size_t span = length - block < 64 ? length - block : 64;
+    uint64_t tokens = brainfuck_compile_tokens(src + block, span);
+    while (success && tokens != 0) {
+      size_t i = block + brainfuck_scan_lowest_bit(tokens);
+      tokens &= tokens - 1;
+      if (src[i] == BRAINFUCK_TOKEN_LOOP_END && depth == 0) {
+        print_error_unmatched_loop_end_at(i);
+        success = false;
+        break;
+      }
+      size_t size = program->size;
+      success = brainfuck_compile_token(state, program, src[i], &depth);
+      /* A folded token belongs to the instruction its run started. */
+      if (success && program->sources != NULL && program->size > size) {
+        program->sources[program->size - 1] = i;
+      }
+    }
+  }
+  if (success && depth > 0) {
+    /* The last `[` that no `]` after it closes is the one left open. */
+    size_t open = length;
+    size_t closed = 0;
+    while (open > 0) {
+      open -= 1;
+      if (src[open] == BRAINFUCK_TOKEN_LOOP_END) {
+        closed += 1;
+      } else if (src[open] == BRAINFUCK_TOKEN_LOOP_START) {
+        if (closed == 0) {
+          break;
+        }
+        closed -= 1;
+      }
+    }
+    print_error_unmatched_loop_start_at(open);
+    success = false;
+  }
+  state->stats.parse_time += brainfuck_clock() - started;
+  return success;
+}
+
+/**
+ * @brief Replace an innermost loop with a clear, multiply or scan instruction
+ * if it has one of these shapes.
+ * @param output The program to append the replacement to.
+ * @param body The instructions of the loop body.
+ * @param length The number of instructions of the loop body.
+ * @param span The number of cells a loop may reach before two offsets could
+ * refer to the same cell of a wrapping tape.
+ * @param replaced Set to true if the loop is replaced.
+ * @return True if the replacement is appended successfully.
+ */
+bool brainfuck_optimize_loop(struct brainfuck_program *output,
+                             const struct brainfuck_instruction *body,
+                             size_t length, size_t span, bool *replaced) {
+  *replaced = false;
+  for (size_t i = 0; i < length; i += 1) {
+    if (body[i].opcode != BRAINFUCK_OP_ADD &&
+        body[i].opcode != BRAINFUCK_OP_MOVE) {
+      return true;
+    }
+  }
+  /* `[>]`, `[<<]` and alike scan for a zero cell. */
+  if (length == 1 && body[0].opcode == BRAINFUCK_OP_MOVE) {
+    *replaced = true;
+    return brainfuck_program_emit(output, BRAINFUCK_OP_SCAN, 0,
+                                  body[0].argument);
+  }
+  /* Collect the total addition of every cell touched by one iteration. */
+  int32_t *offsets = malloc(sizeof(int32_t) * (length + 1));
+  uint8_t *amounts = malloc(sizeof(uint8_t) * (length + 1));
+  if (offsets == NULL || amounts == NULL) {
+    free(offsets);
+    free(amounts);
+    return false;
+  }
+  size_t cells = 0;
+  int64_t current = 0;
+  int64_t lowest = 0;
+  int64_t highest = 0;
+  bool balanced = true;
+  for (size_t i = 0; balanced && i < length; i += 1) {
+    if (body[i].opcode == BRAINFUCK_OP_MOVE) {
+      current += body[i].argument;
+      lowest = current < lowest ? current : lowest;
+      highest = current > highest ? current : highest;
+      /* Keep every offset apart from a wrap, so each cell has one offset. */
+      balanced = highest - lowest < (int64_t)span &&
+                 highest - lowest < BRAINFUCK_MAX_DISTANCE;
+      continue;
+    }
+    size_t cell = 0;
+    while (cell < cells && offsets[cell] != current) {
+      cell += 1;
+    }
+    if (cell == cells) {
+      offsets[cell] = (int32_t)current;
+      amounts[cell] = 0;
+      cells += 1;
+    }
+    amounts[cell] += (uint8_t)body[i].argument;
+  }
+  /* The loop must return to the counter cell and step it by an odd amount,
+   * so that it runs exactly `-value / step` times modulo 256. */
+  uint8_t step = 0;
+  for (size_t cell = 0; cell < cells; cell += 1) {
+    if (offsets[cell] == 0) {
+      step = amounts[cell];
+    }
+  }
+  /* An odd step has an inverse modulo 256, found by Newton's iteration,
+   * which doubles the correct low bits of `a * x == 1` from three. */
+  uint8_t inverse = step;
+  for (int i = 0; i < 2; i += 1) {
+    inverse = (uint8_t)(inverse * (2 - step * inverse));
+  }
+  bool success = true;
+  if (balanced && current == 0 && (step & 1) != 0) {
+    *replaced = true;
+    for (size_t cell = 0; success && cell < cells; cell += 1) {
+      if (offsets[cell] == 0 || amounts[cell] == 0) {
+        continue;
+      }
+      /* Counting down by one multiplies by the amount, and any other odd step
+       * by its negated inverse too. */
+      uint8_t factor = (uint8_t)-(amounts[cell] * inverse);
+      success = brainfuck_program_emit(output, BRAINFUCK_OP_MUL,
+                                       offsets[cell], factor);
+    }
+    success = success && brainfuck_program_emit(output, BRAINFUCK_OP_SET, 0, 0);
+  }
+  free(offsets);
+  free(amounts);
+  return success;
+}
+
+/**
+ * @brief Give the instructions just appended to an optimized program the
+ * source offset of the instruction they replace.
+ * @param output The optimized program, unless it does not track sources.
+ * @param from The index of the first instruction appended.
+ * @param source The source offset.
+ */
+void brainfuck_optimize_locate(struct brainfuck_program *output, size_t from,
+                               size_t source) {
+  if (output->sources == NULL) {
+    return;
+  }
+  for (size_t i = from; i < output->size; i += 1) {
+    output->sources[i] = source;
+  }
+}
+
+/**
+ * @brief Append a move of the memory pointer to a program being rewritten
+ * in place.
+ * @param program The program being rewritten.
+ * @param size The number of instructions rewritten so far, updated.
+ * @param distance The distance to move, nothing is appended if it is 0.
+ * @param source The source offset of the move.
+ */
+void brainfuck_optimize_move(struct brainfuck_program *program, size_t *size,
+                             int32_t distance, size_t source) {
+  if (distance == 0) {
+    return;
+  }
+  struct brainfuck_instruction *move = &program->instructions[*size];
+  move->opcode = BRAINFUCK_OP_MOVE;
+  move->offset = 0;
+  move->argument = distance;
+  if (program->sources != NULL) {
+    program->sources[*size] = source;
+  }
+  *size += 1;
+}
+
+/**
+ * @brief Give every addition and assignment the offset of its cell to where
+ * the memory pointer was last needed, and move the pointer only before an
+ * instruction that needs it. A loop body such as `>+>++<<-` then adds at
+ * offsets 1, 2 and 0 without moving at all, and one that does not return
+ * to its counter moves once per iteration, just before its end.
+ * @param state The state whose loop stack is used to resolve loops.
+ * @param program The program to rewrite in place. It never grows, since
+ * every move put back stands for at least one move taken out.
+ */
+void brainfuck_optimize_offsets(struct brainfuck_state *state,
+                                struct brainfuck_program *program) {
+  size_t *loop_stack = state->loop_stack;
+  size_t loop_stack_size = 0;
+  size_t size = 0;
+  /* The distance the pointer has yet to move, and where that move began. */
+  int32_t pending = 0;
+  size_t moved = 0;
+  for (size_t i = 0; i < program->size; i += 1) {
+    struct brainfuck_instruction instruction = program->instructions[i];
+    size_t source = program->sources == NULL ? 0 : program->sources[i];
+    bool sinks = instruction.opcode == BRAINFUCK_OP_MOVE ||
+                 instruction.opcode == BRAINFUCK_OP_ADD ||
+                 instruction.opcode == BRAINFUCK_OP_SET;
+    int64_t reach = (int64_t)pending + (instruction.opcode == BRAINFUCK_OP_MOVE
+                                            ? instruction.argument
+                                            : instruction.offset);
+    if (!sinks || reach < -BRAINFUCK_MAX_DISTANCE ||
+        reach > BRAINFUCK_MAX_DISTANCE) {
+      brainfuck_optimize_move(program, &size, pending, moved);
+      pending = 0;
+    }
+    switch (instruction.opcode) {
+      case BRAINFUCK_OP_MOVE:
+        moved = pending == 0 ? source : moved;
+        pending += instruction.argument;
+        continue;
+      case BRAINFUCK_OP_ADD:
+      case BRAINFUCK_OP_SET: {
+        instruction.offset += pending;
+        /* An addition after an assignment to the same cell, as in `[-]+`,
+         * is folded into it, so runs of cells stay consecutive. */
+        struct brainfuck_instruction *last =
+            size == 0 ? NULL : &program->instructions[size - 1];
+        if (last != NULL && last->opcode == BRAINFUCK_OP_SET &&
+            last->offset == instruction.offset &&
+            instruction.opcode == BRAINFUCK_OP_ADD) {
+          last->argument = (last->argument + instruction.argument) & UINT8_MAX;
+          continue;
+        }
+        break;
+      }
+      case BRAINFUCK_OP_LOOP_START:
+        loop_stack[loop_stack_size] = size;
+        loop_stack_size += 1;
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        loop_stack_size -= 1;
+        instruction.argument = (int32_t)loop_stack[loop_stack_size];
+        program->instructions[instruction.argument].argument = (int32_t)size;
+        break;
+      default:
+        break;
+    }
+    program->instructions[size] = instruction;
+    if (program->sources != NULL) {
+      program->sources[size] = source;
+    }
+    size += 1;
+  }
+  brainfuck_optimize_move(program, &size, pending, moved);
+  program->size = size;
+}
+
+/**
+ * @brief Optimize a compiled program by replacing common loop idioms with
+ * dedicated instructions.
+ * @param state The state whose loop stack is used to resolve loops.
+ * @param program The program to optimize in place.
+ * @param level The optimization level, 0 leaves the program unchanged and 2
+ * also addresses cells by offset, see `brainfuck_optimize_offsets`.
+ * @return True if the program is optimized successfully.
+ */
+bool brainfuck_optimize(struct brainfuck_state *state,
+                        struct brainfuck_program *program, uint8_t level) {
+  if (state == NULL || program == NULL) {
+    return false;
+  }
+  if (level == 0 || program->size == 0) {
+    return true;
+  }
+  size_t *loop_stack =
+      brainfuck_state_reserve_loop_stack(state, program->max_depth);
+  if (loop_stack == NULL && program->max_depth > 0) {
+    return false;
+  }
+  /* Only a wrapping tape makes distinct offsets refer to the same cell. */
+  size_t span =
+      state->tape == BRAINFUCK_TAPE_FIXED ? state->memory_size : SIZE_MAX;
+  uint64_t started = brainfuck_clock();
+  struct brainfuck_program *output = brainfuck_program_new();
+  if (output == NULL) {
+    return false;
+  }
+  output->max_depth = program->max_depth;
+  size_t loop_stack_size = 0;
+  bool success = program->sources == NULL || brainfuck_program_track(output);
+  for (size_t i = 0; success && i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    /* Whatever replaces an instruction keeps its source offset. */
+    size_t emitted = output->size;
+    size_t source = program->sources == NULL ? 0 : program->sources[i];
+    if (instruction->opcode == BRAINFUCK_OP_LOOP_START) {
+      size_t end = (size_t)instruction->argument;
+      bool replaced = false;
+      success = brainfuck_optimize_loop(output, instruction + 1, end - i - 1,
+                                        span, &replaced);
+      if (replaced) {
+        brainfuck_optimize_locate(output, emitted, source);
+        state->stats.loops_optimized += 1;
+        i = end;
+        continue;
+      }
+      loop_stack[loop_stack_size] = output->size;
+      loop_stack_size += 1;
+      success = success && brainfuck_program_emit(
+                               output, BRAINFUCK_OP_LOOP_START, 0, 0);
+    } else if (instruction->opcode == BRAINFUCK_OP_LOOP_END) {
+      loop_stack_size -= 1;
+      size_t start = loop_stack[loop_stack_size];
+      output->instructions[start].argument = (int32_t)output->size;
+      success = brainfuck_program_emit(output, BRAINFUCK_OP_LOOP_END, 0,
+                                       (int32_t)start);
+    } else {
+      success = brainfuck_program_emit(output, instruction->opcode,
+                                       instruction->offset,
+                                       instruction->argument);
+    }
+    brainfuck_optimize_locate(output, emitted, source);
+  }
+  if (success) {
+    /* Swap the optimized instructions into the program. */
+    struct brainfuck_program swap = *program;
+    *program = *output;
+    *output = swap;
+  }
+  brainfuck_program_free(output);
+  if (success && level >= 2) {
+    brainfuck_optimize_offsets(state, program);
+  }
+  state->stats.optimize_time += brainfuck_clock() - started;
+  return success;
+}
+
+/**
+ * @brief Compile and optimize a whole brainfuck program once, and fold its
+ * start if the options ask for it, to run it
+ * with `brainfuck_program_execute` on any number of contexts created with
+ * the same options.
+ * @param src The brainfuck code to compile.
+ * @param length The length of the brainfuck code.
+ * @param options The options of the contexts the program will run on.
+ * @return The new program of IBF, or NULL if the code does not compile.
+ */
+struct brainfuck_program *brainfuck_program_compile(
+    const char *src, size_t length, const struct brainfuck_options *options) {
+  /* Compiling needs a loop stack and the size of the tape, but no tape. */
+  struct brainfuck_state scratch;
+  memset(&scratch, 0, sizeof(scratch));
+  scratch.tape = options->tape;
+  scratch.memory_size = options->tape_size == 0 ? BRAINFUCK_MEMORY_BUFFER_SIZE
+                                                : options->tape_size;
+  struct brainfuck_program *program = brainfuck_program_new();
+  if (program == NULL || !brainfuck_compile(&scratch, program, src, length) ||
+      !brainfuck_optimize(&scratch, program, options->optimization_level) ||
+      !brainfuck_program_fold(program, options)) {
+    brainfuck_program_free(program);
+    program = NULL;
+  }
+  free(scratch.loop_stack);
+  return program;
+}
+
+/**
+ * @brief Execute a compiled program of IBF with the reference interpreter,
+ * which dispatches every instruction through a switch.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @return True if the program is executed successfully.
+ */
+bool brainfuck_program_execute_switch(struct brainfuck_context *context,
+                                      const struct brainfuck_program *program) {
+  if (context == NULL || program == NULL) {
+    return false;
+  }
+  struct brainfuck_state *state = context->state;
+  size_t execute_pointer = state->resume_pointer;
+  size_t index = 0;
+  bool success = true;
+  while (success && execute_pointer < program->size) {
+    const struct brainfuck_instruction *instruction =
+        &program->instructions[execute_pointer];
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+        if (instruction->offset == 0) {
+          brainfuck_execute_add(context, (uint8_t)instruction->argument);
+          break;
+        }
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          state->memory_buffer[index] += (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_MOVE:
+        success = brainfuck_execute_move(context, instruction->argument);
+        break;
+      case BRAINFUCK_OP_INPUT:
+        success = brainfuck_execute_input(context);
+        if (!success && state->suspended != BRAINFUCK_SUSPEND_NONE) {
+          state->resume_pointer = execute_pointer;
+          return false;
+        }
+        break;
+      case BRAINFUCK_OP_OUTPUT:
+        success = brainfuck_output_repeat(
+            context, state->memory_buffer[state->memory_pointer],
+            (size_t)instruction->argument);
+        if (!success) {
+          state->resume_pointer = execute_pointer;
+          return false;
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_START:
+        /* Skip the loop if value is zero. */
+        if (state->memory_buffer[state->memory_pointer] == 0) {
+          execute_pointer = (size_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        /* Jump back to the loop body if value is not zero. */
+        if (state->memory_buffer[state->memory_pointer] != 0) {
+          execute_pointer = (size_t)instruction->argument;
+          state->fuel -= 1;
+          if (state->fuel == 0 && !brainfuck_budget_refill(state)) {
+            state->resume_pointer = execute_pointer + 1;
+            return false;
+          }
+        }
+        break;
+      case BRAINFUCK_OP_SET:
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          state->memory_buffer[index] = (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_MUL:
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          state->memory_buffer[index] +=
+              state->memory_buffer[state->memory_pointer] *
+              (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_SCAN:
+        success = brainfuck_execute_scan(context, instruction->argument);
+        if (!success && state->suspended != BRAINFUCK_SUSPEND_NONE) {
+          state->resume_pointer = execute_pointer;
+          return false;
+        }
+        break;
+      default:
+        break;
+    }
+    execute_pointer += 1;
+  }
+  return success;
+}
+
+/**
+ * @brief Count the cells a scan visited in a profile.
+ * @param profile The profile of IBF.
+ * @param state The state of IBF.
+ * @param from The cell the scan started at.
+ * @param to The cell the scan stopped at.
+ * @param stride The distance of every move.
+ * @param last Whether the scan read the cell it stopped at, which a scan
+ * suspended there reads again once it is resumed.
+ */
+void brainfuck_profile_scan(struct brainfuck_profile *profile,
+                            struct brainfuck_state *state, size_t from,
+                            size_t to, int32_t stride, bool last) {
+  size_t index = from;
+  while (index != to) {
+    brainfuck_profile_touch(profile, index);
+    if (!brainfuck_memory_index(state, index, stride, &index)) {
+      return;
+    }
+  }
+  if (last) {
+    brainfuck_profile_touch(profile, to);
+  }
+}
+
+/**
+ * @brief Execute a compiled program of IBF with the profile engine, which is
+ * the reference interpreter counting every instruction, every run of two or
+ * three of them one after the other, the time of every top-level loop and
+ * every cell accessed into the profile of the context.
+ * The other engines carry none of this.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @return True if the program is executed successfully.
+ */
+bool brainfuck_program_execute_profile(
+    struct brainfuck_context *context,
+    const struct brainfuck_program *program) {
+  if (context == NULL || program == NULL) {
+    return false;
+  }
+  struct brainfuck_profile *profile = context->profile;
+  if (profile == NULL) {
+    return brainfuck_program_execute_switch(context, program);
+  }
+  if (!brainfuck_profile_reserve(profile, program->size)) {
+    return false;
+  }
+  struct brainfuck_state *state = context->state;
+  size_t execute_pointer = state->resume_pointer;
+  size_t index = 0;
+  size_t from = 0;
+  /* The instructions run one after the other up to the last one. */
+  size_t run = 0;
+  size_t last = 0;
+  bool success = true;
+  /* A suspended loop is timed again from here. */
+  if (profile->loop != SIZE_MAX) {
+    profile->entered = brainfuck_clock();
+  }
+  while (success && execute_pointer < program->size) {
+    const struct brainfuck_instruction *instruction =
+        &program->instructions[execute_pointer];
+    profile->counts[execute_pointer] += 1;
+    /* Count the runs that a superinstruction could fuse. */
+    run = run > 0 && execute_pointer == last + 1 ? run + 1 : 1;
+    if (run >= 2) {
+      profile->follows[execute_pointer - 1] += 1;
+    }
+    if (run >= 3) {
+      profile->chains[execute_pointer - 2] += 1;
+    }
+    last = execute_pointer;
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          brainfuck_profile_touch(profile, index);
+          state->memory_buffer[index] += (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_MOVE:
+        success = brainfuck_execute_move(context, instruction->argument);
+        break;
+      case BRAINFUCK_OP_INPUT:
+        success = brainfuck_execute_input(context);
+        if (!success && state->suspended != BRAINFUCK_SUSPEND_NONE) {
+          /* The input is counted once it is resumed. */
+          profile->counts[execute_pointer] -= 1;
+          state->resume_pointer = execute_pointer;
+        } else if (success) {
+          brainfuck_profile_touch(profile, state->memory_pointer);
+        }
+        break;
+      case BRAINFUCK_OP_OUTPUT:
+        success = brainfuck_output_repeat(
+            context, state->memory_buffer[state->memory_pointer],
+            (size_t)instruction->argument);
+        if (!success) {
+          profile->counts[execute_pointer] -= 1;
+          state->resume_pointer = execute_pointer;
+        } else {
+          brainfuck_profile_touch(profile, state->memory_pointer);
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_START:
+        brainfuck_profile_touch(profile, state->memory_pointer);
+        if (state->memory_buffer[state->memory_pointer] == 0) {
+          execute_pointer = (size_t)instruction->argument;
+        } else if (profile->loop == SIZE_MAX) {
+          /* Entering a loop outside any other starts timing it. */
+          profile->loop = execute_pointer;
+          profile->entered = brainfuck_clock();
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        brainfuck_profile_touch(profile, state->memory_pointer);
+        if (state->memory_buffer[state->memory_pointer] != 0) {
+          execute_pointer = (size_t)instruction->argument;
+          state->fuel -= 1;
+          if (state->fuel == 0 && !brainfuck_budget_refill(state)) {
+            state->resume_pointer = execute_pointer + 1;
+            success = false;
+          }
+        } else if (profile->loop == (size_t)instruction->argument) {
+          profile->times[profile->loop] += brainfuck_clock() - profile->entered;
+          profile->loop = SIZE_MAX;
+        }
+        break;
+      case BRAINFUCK_OP_SET:
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          brainfuck_profile_touch(profile, index);
+          state->memory_buffer[index] = (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_MUL:
+        success = brainfuck_memory_index(state, state->memory_pointer,
+                                         instruction->offset, &index);
+        if (success) {
+          brainfuck_profile_touch(profile, state->memory_pointer);
+          brainfuck_profile_touch(profile, index);
+          state->memory_buffer[index] +=
+              state->memory_buffer[state->memory_pointer] *
+              (uint8_t)instruction->argument;
+        }
+        break;
+      case BRAINFUCK_OP_SCAN:
+        from = state->memory_pointer;
+        success = brainfuck_execute_scan(context, instruction->argument);
+        if (success || state->suspended != BRAINFUCK_SUSPEND_NONE) {
+          brainfuck_profile_scan(profile, state, from, state->memory_pointer,
+                                 instruction->argument, success);
+        }
+        if (!success && state->suspended != BRAINFUCK_SUSPEND_NONE) {
+          profile->counts[execute_pointer] -= 1;
+          state->resume_pointer = execute_pointer;
+        }
+        break;
+      default:
+        break;
+    }
+    execute_pointer += 1;
+  }
+  if (profile->loop != SIZE_MAX) {
+    profile->times[profile->loop] += brainfuck_clock() - profile->entered;
+  }
+  return success;
+}
+
+/**
+ * @brief Check that a program can run without bounds checks on the guarded
+ * tape of a state. Every cell accessed off the tape must then fall in a
+ * guard, so the memory pointer may drift at most a guard away from the last
+ * cell it accessed, which was on the tape.
+ * @param state The state of IBF.
+ * @param program The program to check.
+ * @return True if the program can run unchecked.
+ */
+bool brainfuck_program_guarded(const struct brainfuck_state *state,
+                               const struct brainfuck_program *program) {
+  if (state == NULL || program == NULL || state->memory_guard == 0) {
+    return false;
+  }
+  const int64_t guard = (int64_t)state->memory_guard;
+  int64_t drift = 0;
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    int64_t reach = drift;
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_MOVE:
+        drift += instruction->argument;
+        reach = drift;
+        break;
+      case BRAINFUCK_OP_ADD:
+      case BRAINFUCK_OP_SET:
+        reach = drift + instruction->offset;
+        if (instruction->offset == 0) {
+          drift = 0;
+        }
+        break;
+      case BRAINFUCK_OP_MUL:
+        /* The current cell is read first, then the one at the offset. */
+        if (drift > guard || drift < -guard) {
+          return false;
+        }
+        drift = 0;
+        reach = instruction->offset;
+        break;
+      default:
+        /* Every other instruction accesses the current cell. */
+        drift = 0;
+        break;
+    }
+    if (reach > guard || reach < -guard) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#if defined(BRAINFUCK_HAVE_MMAP)
+/**
+ * @brief Where an unchecked run on a guarded tape resumes after a fault.
+ */
+static _Thread_local sigjmp_buf *brainfuck_guard_jump = NULL;
+
+/**
+ * @brief The state whose guarded tape an unchecked run is using.
+ */
+static _Thread_local const struct brainfuck_state *brainfuck_guard_state =
+    NULL;
+
+/**
+ * @brief The handler of SIGSEGV before IBF installs its own.
+ */
+static struct sigaction brainfuck_guard_previous;
+
+/**
+ * @brief Whether the handler of IBF is installed, once for all threads.
+ */
+static pthread_once_t brainfuck_guard_once = PTHREAD_ONCE_INIT;
+static bool brainfuck_guard_installed = false;
+
+/**
+ * @brief Handle SIGSEGV by resuming the unchecked run that faulted in a
+ * guard of its tape. Any other fault goes to the previous handler.
+ * @param signal The signal number.
+ * @param info The information of the signal.
+ * @param ucontext The interrupted context.
+ */
+void brainfuck_guard_handler(int signal, siginfo_t *info, void *ucontext) {
+  const struct brainfuck_state *state = brainfuck_guard_state;
+  if (brainfuck_guard_jump != NULL && state != NULL) {
+    uintptr_t address = (uintptr_t)info->si_addr;
+    uintptr_t begin = (uintptr_t)state->memory_buffer - state->memory_guard;
+    uintptr_t end = (uintptr_t)state->memory_buffer + state->memory_limit +
+                    state->memory_guard;
+    if (address >= begin && address < end) {
+      siglongjmp(*brainfuck_guard_jump, 1);
+    }
+  }
+  if (brainfuck_guard_previous.sa_flags & SA_SIGINFO) {
+    brainfuck_guard_previous.sa_sigaction(signal, info, ucontext);
+    return;
+  }
+  /* Return to fault again without the handler. */
+  sigaction(SIGSEGV, &brainfuck_guard_previous, NULL);
+}
+
+/**
+ * @brief Install the handler of faults in the guards.
+ */
+void brainfuck_guard_install() {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = brainfuck_guard_handler;
+  /* The handler jumps out, so SIGSEGV must not stay blocked. */
+  action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+  brainfuck_guard_installed =
+      sigaction(SIGSEGV, &action, &brainfuck_guard_previous) == 0;
+}
+
+/**
+ * @brief Let faults in the guards of a state resume at a jump buffer,
+ * installing the handler the first time on any thread.
+ * @param state The state whose guarded tape is used.
+ * @param jump The jump buffer to resume at.
+ * @return True if faults are handled.
+ */
+bool brainfuck_guard_enter(const struct brainfuck_state *state,
+                           sigjmp_buf *jump) {
+  pthread_once(&brainfuck_guard_once, brainfuck_guard_install);
+  if (!brainfuck_guard_installed) {
+    return false;
+  }
+  brainfuck_guard_state = state;
+  brainfuck_guard_jump = jump;
+  return true;
+}
+
+/**
+ * @brief Stop handling faults in the guards.
+ */
+void brainfuck_guard_leave() {
+  brainfuck_guard_jump = NULL;
+  brainfuck_guard_state = NULL;
+}
+
+/**
+ * @brief Check where an unchecked run left the memory pointer, which may be
+ * off the tape without having faulted, as a checked move would report.
+ * @param state The state of IBF.
+ * @param success Whether the run succeeded.
+ * @return True if the run succeeded on the tape.
+ */
+bool brainfuck_guard_check(const struct brainfuck_state *state,
+                           bool success) {
+  if (success && state->memory_pointer >= state->memory_size) {
+    print_error_tape_out_of_range(state);
+    return false;
+  }
+  return success;
+}
+#endif
+
+/**
+ * @brief Run a compiled program of IBF in the threaded interpreter. Every
+ * instruction jumps straight to the handler of the next one through labels
+ * as values, and the memory pointer is kept in a local. The runs of
+ * instructions listed in `superinstructions.def` are threaded to one
+ * handler that runs them all, which saves a dispatch for each but the
+ * first. Compilers without labels as values fall back to a switch.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @param checked Whether cells are checked against the accessible memory.
+ * Unchecked moves and accesses are threaded to their own handlers, so the
+ * checked ones carry no extra test. The fallback and superinstructions
+ * always check.
+ * @return True if the program is executed successfully.
+ */
+bool brainfuck_threaded_run(struct brainfuck_context *context,
+                            const struct brainfuck_program *program,
+                            bool checked) {
+  struct brainfuck_state *state = context->state;
+  const struct brainfuck_instruction *code = program->instructions;
+  uint8_t *memory = state->memory_buffer;
+  size_t size = state->memory_size;
+  size_t pointer = state->memory_pointer;
+  size_t pc = state->resume_pointer;
+  size_t index = 0;
+  uint64_t fuel = state->fuel;
+  bool success = true;
+#if defined(__GNUC__)
+  static void *const labels[] = {
+      [BRAINFUCK_OP_ADD] = &&label_add_offset,
+      [BRAINFUCK_OP_MOVE] = &&label_move,
+      [BRAINFUCK_OP_INPUT] = &&label_input,
+      [BRAINFUCK_OP_OUTPUT] = &&label_output,
+      [BRAINFUCK_OP_LOOP_START] = &&label_loop_start,
+      [BRAINFUCK_OP_LOOP_END] = &&label_loop_end,
+      [BRAINFUCK_OP_SET] = &&label_set,
+      [BRAINFUCK_OP_MUL] = &&label_mul,
+      [BRAINFUCK_OP_SCAN] = &&label_scan,
+  };
+  static void *const unchecked_labels[] = {
+      [BRAINFUCK_OP_MOVE] = &&label_move_unchecked,
+      [BRAINFUCK_OP_SET] = &&label_set_unchecked,
+      [BRAINFUCK_OP_MUL] = &&label_mul_unchecked,
+      [BRAINFUCK_OP_SCAN] = NULL, /* Sized to cover every opcode. */
+  };
+  /* The superinstructions, longest first, ended by one of length 0. */
+  static const struct {
+    uint8_t opcodes[3];
+    size_t length;
+    void *label;
+  } superinstructions[] = {
+#define BRAINFUCK_SUPERINSTRUCTION2(first, second)       \
+  {{BRAINFUCK_OP_##first, BRAINFUCK_OP_##second, 0}, 2, \
+   &&label_##first##_##second},
+#define BRAINFUCK_SUPERINSTRUCTION3(first, second, third)                    \
+  {{BRAINFUCK_OP_##first, BRAINFUCK_OP_##second, BRAINFUCK_OP_##third}, 3, \
+   &&label_##first##_##second##_##third},
+#include "superinstructions.def"
+#undef BRAINFUCK_SUPERINSTRUCTION2
+#undef BRAINFUCK_SUPERINSTRUCTION3
+      {{0, 0, 0}, 0, NULL},
+  };
+  /* Thread the code once, with a trailing handler to stop at the end. */
+  void **threaded = brainfuck_state_reserve_threaded(state, program->size + 1);
+  if (threaded == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < program->size; i += 1) {
+    uint8_t opcode = code[i].opcode;
+    threaded[i] = !checked && unchecked_labels[opcode] != NULL
+                      ? unchecked_labels[opcode]
+                      : labels[opcode];
+    /* An addition to the current cell needs no lookup at all. */
+    if (opcode == BRAINFUCK_OP_ADD) {
+      threaded[i] = code[i].offset == 0 ? &&label_add
+                    : checked           ? &&label_add_offset
+                                        : &&label_add_offset_unchecked;
+    }
+    /* Every instruction keeps a handler of its own to be jumped to, even
+     * inside a superinstruction. */
+    for (size_t s = 0; superinstructions[s].length > 0; s += 1) {
+      size_t length = superinstructions[s].length;
+      size_t j = 0;
+      while (j < length && i + j < program->size &&
+             code[i + j].opcode == superinstructions[s].opcodes[j]) {
+        j += 1;
+      }
+      if (j == length) {
+        threaded[i] = superinstructions[s].label;
+        break;
+      }
+    }
+  }
+  threaded[program->size] = &&label_halt;
+#define BRAINFUCK_THREADED_CASE(opcode, label) label:
+#define BRAINFUCK_THREADED_NEXT() goto *threaded[++pc]
+  goto *threaded[pc];
+#else
+#define BRAINFUCK_THREADED_CASE(opcode, label) case opcode:
+#define BRAINFUCK_THREADED_NEXT() \
+  pc += 1;                        \
+  continue
+  while (pc < program->size) {
+    switch (code[pc].opcode) {
+#endif
+/* Find the cell at an offset, leaving the fast path only when it falls
+ * outside the accessible memory, which may move or grow the tape. */
+#define BRAINFUCK_THREADED_LOCATE(offset)                              \
+  index = pointer + (size_t)(offset);                                  \
+  if (index >= size) {                                                 \
+    if (!brainfuck_tape_locate(state, pointer, (offset), &index)) {    \
+      success = false;                                                 \
+      goto label_halt;                                                 \
+    }                                                                  \
+    memory = state->memory_buffer;                                     \
+    size = state->memory_size;                                         \
+  }
+/* The checked body of each opcode, which handlers and superinstructions
+ * are made of. Only a loop start or end changes `pc`, so it can only end a
+ * superinstruction. */
+#define BRAINFUCK_THREADED_ADD()                \
+  BRAINFUCK_THREADED_LOCATE(code[pc].offset);   \
+  memory[index] += (uint8_t)code[pc].argument
+#define BRAINFUCK_THREADED_MOVE()                 \
+  BRAINFUCK_THREADED_LOCATE(code[pc].argument);   \
+  pointer = index
+#define BRAINFUCK_THREADED_INPUT()                     \
+  if (!brainfuck_input(context, &memory[pointer])) {   \
+    state->resume_pointer = pc;                        \
+    success = false;                                   \
+    goto label_halt;                                   \
+  }
+#define BRAINFUCK_THREADED_OUTPUT()                                \
+  if (!brainfuck_output_repeat(context, memory[pointer],           \
+                               (size_t)code[pc].argument)) {       \
+    state->resume_pointer = pc;                                    \
+    success = false;                                               \
+    goto label_halt;                                               \
+  }
+#define BRAINFUCK_THREADED_LOOP_START() \
+  if (memory[pointer] == 0) {           \
+    pc = (size_t)code[pc].argument;     \
+  }
+#define BRAINFUCK_THREADED_LOOP_END()             \
+  if (memory[pointer] != 0) {                     \
+    pc = (size_t)code[pc].argument;               \
+    fuel -= 1;                                    \
+    if (fuel == 0) {                              \
+      state->fuel = 0;                            \
+      if (!brainfuck_budget_refill(state)) {      \
+        state->resume_pointer = pc + 1;           \
+        success = false;                          \
+        goto label_halt;                          \
+      }                                           \
+      fuel = state->fuel;                         \
+    }                                             \
+  }
+#define BRAINFUCK_THREADED_SET()                \
+  BRAINFUCK_THREADED_LOCATE(code[pc].offset);   \
+  memory[index] = (uint8_t)code[pc].argument
+#define BRAINFUCK_THREADED_MUL()                \
+  BRAINFUCK_THREADED_LOCATE(code[pc].offset);   \
+  memory[index] += memory[pointer] * (uint8_t)code[pc].argument
+#define BRAINFUCK_THREADED_SCAN()                                      \
+  state->fuel = fuel;                                                  \
+  success = brainfuck_memory_scan(state, &pointer, code[pc].argument); \
+  fuel = state->fuel;                                                  \
+  if (!success) {                                                      \
+    state->resume_pointer = pc;                                        \
+    goto label_halt;                                                   \
+  }                                                                    \
+  memory = state->memory_buffer;                                       \
+  size = state->memory_size
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_ADD, label_add_offset)
+    BRAINFUCK_THREADED_ADD();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_MOVE, label_move)
+    BRAINFUCK_THREADED_MOVE();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_INPUT, label_input)
+    BRAINFUCK_THREADED_INPUT();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_OUTPUT, label_output)
+    BRAINFUCK_THREADED_OUTPUT();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_LOOP_START, label_loop_start)
+    BRAINFUCK_THREADED_LOOP_START();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_LOOP_END, label_loop_end)
+    BRAINFUCK_THREADED_LOOP_END();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_SET, label_set)
+    BRAINFUCK_THREADED_SET();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_MUL, label_mul)
+    BRAINFUCK_THREADED_MUL();
+    BRAINFUCK_THREADED_NEXT();
+  BRAINFUCK_THREADED_CASE(BRAINFUCK_OP_SCAN, label_scan)
+    BRAINFUCK_THREADED_SCAN();
+    BRAINFUCK_THREADED_NEXT();
+#if defined(__GNUC__)
+label_add:
+  memory[pointer] += (uint8_t)code[pc].argument;
+  BRAINFUCK_THREADED_NEXT();
+  /* On a guarded tape, cells off the tape fault in a guard instead. */
+label_add_offset_unchecked:
+  memory[pointer + (size_t)code[pc].offset] += (uint8_t)code[pc].argument;
+  BRAINFUCK_THREADED_NEXT();
+label_move_unchecked:
+  pointer += (size_t)code[pc].argument;
+  BRAINFUCK_THREADED_NEXT();
+label_set_unchecked:
+  memory[pointer + (size_t)code[pc].offset] = (uint8_t)code[pc].argument;
+  BRAINFUCK_THREADED_NEXT();
+label_mul_unchecked:
+  memory[pointer + (size_t)code[pc].offset] +=
+      memory[pointer] * (uint8_t)code[pc].argument;
+  BRAINFUCK_THREADED_NEXT();
+#define BRAINFUCK_SUPERINSTRUCTION2(first, second) \
+  label_##first##_##second:                        \
+  BRAINFUCK_THREADED_##first();                    \
+  pc += 1;                                         \
+  BRAINFUCK_THREADED_##second();                   \
+  BRAINFUCK_THREADED_NEXT();
+#define BRAINFUCK_SUPERINSTRUCTION3(first, second, third) \
+  label_##first##_##second##_##third:                     \
+  BRAINFUCK_THREADED_##first();                           \
+  pc += 1;                                                \
+  BRAINFUCK_THREADED_##second();                          \
+  pc += 1;                                                \
+  BRAINFUCK_THREADED_##third();                           \
+  BRAINFUCK_THREADED_NEXT();
+#include "superinstructions.def"
+#undef BRAINFUCK_SUPERINSTRUCTION2
+#undef BRAINFUCK_SUPERINSTRUCTION3
+#else
+    default:
+      pc += 1;
+      continue;
+    }
+  }
+  (void)checked;
+#endif
+label_halt:
+#undef BRAINFUCK_THREADED_CASE
+#undef BRAINFUCK_THREADED_NEXT
+#undef BRAINFUCK_THREADED_LOCATE
+#undef BRAINFUCK_THREADED_ADD
+#undef BRAINFUCK_THREADED_MOVE
+#undef BRAINFUCK_THREADED_INPUT
+#undef BRAINFUCK_THREADED_OUTPUT
+#undef BRAINFUCK_THREADED_LOOP_START
+#undef BRAINFUCK_THREADED_LOOP_END
+#undef BRAINFUCK_THREADED_SET
+#undef BRAINFUCK_THREADED_MUL
+#undef BRAINFUCK_THREADED_SCAN
+  state->memory_pointer = pointer;
+  state->fuel = fuel;
+  return success;
+}
+
+/**
+ * @brief Execute a compiled program of IBF with the threaded interpreter.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @return True if the program is executed successfully.
+ */
+bool brainfuck_program_execute_threaded(
+    struct brainfuck_context *context,
+    const struct brainfuck_program *program) {
+  if (context == NULL || program == NULL) {
+    return false;
+  }
+  if (program->size == 0) {
+    return true;
+  }
+  return brainfuck_threaded_run(context, program, true);
+}
+
+/**
+ * @brief Execute a compiled program of IBF with the threaded interpreter
+ * and no bounds checks, on a guarded tape that it cannot run past, see
+ * `brainfuck_program_guarded`. Running off the tape faults in a guard and
+ * is reported as a tape error, leaving the memory pointer where the run
+ * started.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @return True if the program is executed successfully.
+ */
+bool brainfuck_program_execute_threaded_unchecked(
+    struct brainfuck_context *context,
+    const struct brainfuck_program *program) {
+  if (context == NULL || program == NULL) {
+    return false;
+  }
+  if (program->size == 0) {
+    return true;
+  }
+#if defined(BRAINFUCK_HAVE_MMAP)
+  sigjmp_buf jump;
+  if (!brainfuck_guard_enter(context->state, &jump)) {
+    return brainfuck_threaded_run(context, program, true);
+  }
+  if (sigsetjmp(jump, 0) != 0) {
+    brainfuck_guard_leave();
+    print_error_tape_out_of_range(context->state);
+    return false;
+  }
+  bool success = brainfuck_threaded_run(context, program, false);
+  brainfuck_guard_leave();
+  return brainfuck_guard_check(context->state, success);
+#else
+  return brainfuck_threaded_run(context, program, true);
+#endif
+}
+
+#if defined(BRAINFUCK_JIT_X86_64)
+/**
+ * @brief The machine code generated by the JIT compiler.
+ */
+struct brainfuck_jit_code {
+  uint8_t *bytes;  /* The machine code. */
+  size_t size;     /* The size of the machine code. */
+  size_t capacity; /* The allocated size of the machine code. */
+  bool failed;     /* Whether the machine code ran out of memory. */
+};
+
+/**
+ * @brief The signature of a JIT compiled program, which runs on the memory of
+ * the state from the code of an entry and returns false after a tape error.
+ */
+typedef bool (*brainfuck_jit_function)(struct brainfuck_context *context,
+                                       struct brainfuck_state *state,
+                                       const uint8_t *entry);
+
+/**
+ * @brief Append bytes of machine code.
+ * @param code The machine code.
+ * @param bytes The bytes to append.
+ * @param size The number of bytes to append.
+ */
+void brainfuck_jit_emit(struct brainfuck_jit_code *code, const void *bytes,
+                        size_t size) {
+  if (code->failed) {
+    return;
+  }
+  if (code->size + size > code->capacity) {
+    size_t capacity = (code->size + size) * 2;
+    uint8_t *grown = realloc(code->bytes, capacity);
+    if (grown == NULL) {
+      /* The rest is not written, and the code is not run. */
+      code->failed = true;
+      return;
+    }
+    code->bytes = grown;
+    code->capacity = capacity;
+  }
+  memcpy(code->bytes + code->size, bytes, size);
+  code->size += size;
+}
+
+/**
+ * @brief Append a little-endian 32-bit immediate.
+ * @param code The machine code.
+ * @param value The immediate to append.
+ */
+void brainfuck_jit_emit_u32(struct brainfuck_jit_code *code, uint32_t value) {
+  const uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8),
+                            (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  brainfuck_jit_emit(code, bytes, sizeof(bytes));
+}
+
+/**
+ * @brief Patch a byte of machine code already appended, such as the
+ * displacement of a forward jump.
+ * @param code The machine code.
+ * @param position The position of the byte.
+ * @param value The byte.
+ */
+void brainfuck_jit_patch_u8(struct brainfuck_jit_code *code, size_t position,
+                            uint8_t value) {
+  if (!code->failed) {
+    code->bytes[position] = value;
+  }
+}
+
+/**
+ * @brief Patch a little-endian 32-bit immediate already appended.
+ * @param code The machine code.
+ * @param position The position of the immediate.
+ * @param value The immediate.
+ */
+void brainfuck_jit_patch_u32(struct brainfuck_jit_code *code, size_t position,
+                             uint32_t value) {
+  if (!code->failed) {
+    memcpy(code->bytes + position, &value, sizeof(value));
+  }
+}
+
+/**
+ * @brief Append a call to a C function, `mov rax, function; call rax`.
+ * @param code The machine code.
+ * @param function The address of the function.
+ */
+void brainfuck_jit_emit_call(struct brainfuck_jit_code *code,
+                             uintptr_t function) {
+  const uint8_t mov_rax[] = {0x48, 0xB8};
+  brainfuck_jit_emit(code, mov_rax, sizeof(mov_rax));
+  brainfuck_jit_emit_u32(code, (uint32_t)function);
+  brainfuck_jit_emit_u32(code, (uint32_t)((uint64_t)function >> 32));
+  const uint8_t call_rax[] = {0xFF, 0xD0};
+  brainfuck_jit_emit(code, call_rax, sizeof(call_rax));
+}
+
+/**
+ * @brief Append a load of a field of the state in `r14`, such as
+ * `mov rbx, [r14+offset]`.
+ * @param code The machine code.
+ * @param opcode The REX prefix, opcode and ModRM byte of the instruction.
+ * @param field The offset of the field in the state.
+ */
+void brainfuck_jit_emit_field(struct brainfuck_jit_code *code,
+                              const uint8_t opcode[3], size_t field) {
+  brainfuck_jit_emit(code, opcode, 3);
+  brainfuck_jit_emit_u32(code, (uint32_t)field);
+}
+
+/**
+ * @brief Append a jump to the exit that reports an error when `rax` holds
+ * `SIZE_MAX`, which is the result of the helpers on tape errors.
+ * @param code The machine code.
+ * @param error The position of the error exit, which precedes the jump.
+ */
+void brainfuck_jit_emit_check(struct brainfuck_jit_code *code, size_t error) {
+  /* cmp rax, -1; je rel32 */
+  const uint8_t check[] = {0x48, 0x83, 0xF8, 0xFF, 0x0F, 0x84};
+  brainfuck_jit_emit(code, check, sizeof(check));
+  brainfuck_jit_emit_u32(code, (uint32_t)(error - (code->size + 4)));
+}
+
+/**
+ * @brief Find the cell at an offset to the memory pointer for JIT compiled
+ * code, once it falls outside the accessible memory.
+ * @param state The state of IBF.
+ * @param pointer The memory pointer.
+ * @param offset The offset of the cell.
+ * @return The index of the cell, or `SIZE_MAX` after a tape error.
+ */
+size_t brainfuck_jit_locate(struct brainfuck_state *state, size_t pointer,
+                            int32_t offset) {
+  size_t index = 0;
+  return brainfuck_tape_locate(state, pointer, offset, &index) ? index
+                                                               : SIZE_MAX;
+}
+
+/**
+ * @brief Run a scan loop for JIT compiled code.
+ * @param state The state of IBF.
+ * @param pointer The memory pointer to start from.
+ * @param stride The distance of every move.
+ * @param resume The index of the scan, where a suspended run resumes.
+ * @return The index of the zero cell, or `SIZE_MAX` after a tape error or
+ * once the budget is spent.
+ */
+size_t brainfuck_jit_scan(struct brainfuck_state *state, size_t pointer,
+                          int32_t stride, size_t resume) {
+  if (brainfuck_memory_scan(state, &pointer, stride)) {
+    return pointer;
+  }
+  /* A resumed run scans again from where this scan started. */
+  state->resume_pointer = resume;
+  return SIZE_MAX;
+}
+
+/**
+ * @brief Refill the fuel for JIT compiled code once it runs out.
+ * @param state The state of IBF.
+ * @param resume The instruction a suspended run resumes at.
+ * @return `SIZE_MAX` if the budget is spent.
+ */
+size_t brainfuck_jit_refill(struct brainfuck_state *state, size_t resume) {
+  state->fuel = 0;
+  if (brainfuck_budget_refill(state)) {
+    return 0;
+  }
+  state->resume_pointer = resume;
+  return SIZE_MAX;
+}
+
+/**
+ * @brief Append the computation of the index of the cell at an offset into
+ * `rax`, as `brainfuck_memory_index` does. Cells outside the accessible
+ * memory are found by `brainfuck_jit_locate`, which may move the memory.
+ * @param code The machine code.
+ * @param offset The offset of the cell.
+ * @param error The position of the error exit.
+ * @param checked Whether the cell is checked, rather than left to fault in a
+ * guard of the tape.
+ */
+void brainfuck_jit_emit_index(struct brainfuck_jit_code *code, int32_t offset,
+                              size_t error, bool checked) {
+  const uint8_t lea_rax[] = {0x49, 0x8D, 0x84, 0x24}; /* lea rax, [r12+d] */
+  brainfuck_jit_emit(code, lea_rax, sizeof(lea_rax));
+  brainfuck_jit_emit_u32(code, (uint32_t)offset);
+  if (!checked) {
+    return;
+  }
+  const uint8_t cmp_rax[] = {0x49, 0x3B, 0x86}; /* cmp rax, [r14+size] */
+  brainfuck_jit_emit_field(code, cmp_rax,
+                           offsetof(struct brainfuck_state, memory_size));
+  const uint8_t jb[] = {0x72, 0x00}; /* jb over the slow path */
+  brainfuck_jit_emit(code, jb, sizeof(jb));
+  size_t skip = code->size;
+  /* mov rdi, r14; mov rsi, r12; mov edx, imm32 */
+  const uint8_t load[] = {0x4C, 0x89, 0xF7, 0x4C, 0x89, 0xE6, 0xBA};
+  brainfuck_jit_emit(code, load, sizeof(load));
+  brainfuck_jit_emit_u32(code, (uint32_t)offset);
+  brainfuck_jit_emit_call(code, (uintptr_t)brainfuck_jit_locate);
+  brainfuck_jit_emit_check(code, error);
+  const uint8_t reload[] = {0x49, 0x8B, 0x9E}; /* mov rbx, [r14+buffer] */
+  brainfuck_jit_emit_field(code, reload,
+                           offsetof(struct brainfuck_state, memory_buffer));
+  brainfuck_jit_patch_u8(code, skip - 1, (uint8_t)(code->size - skip));
+}
+
+/**
+ * @brief Append an addition or an assignment to the cell at its offset.
+ * @param code The machine code.
+ * @param instruction The `BRAINFUCK_OP_ADD` or `BRAINFUCK_OP_SET`.
+ * @param error The position of the error exit.
+ * @param checked Whether the cell is checked against the accessible memory.
+ */
+void brainfuck_jit_emit_cell(struct brainfuck_jit_code *code,
+                             const struct brainfuck_instruction *instruction,
+                             size_t error, bool checked) {
+  uint8_t value = (uint8_t)instruction->argument;
+  if (instruction->opcode == BRAINFUCK_OP_ADD && instruction->offset == 0) {
+    const uint8_t add[] = {0x42, 0x80, 0x04, 0x23, value}; /* add [rbx+r12] */
+    brainfuck_jit_emit(code, add, sizeof(add));
+    return;
+  }
+  brainfuck_jit_emit_index(code, instruction->offset, error, checked);
+  /* add byte [rbx+rax], imm8 or mov byte [rbx+rax], imm8 */
+  const uint8_t cell[] = {
+      instruction->opcode == BRAINFUCK_OP_ADD ? 0x80 : 0xC6, 0x04, 0x03,
+      value};
+  brainfuck_jit_emit(code, cell, sizeof(cell));
+}
+
+/**
+ * @brief Count the additions and assignments to consecutive cells from an
+ * instruction on, which `brainfuck_jit_emit_block` can run as one.
+ * @param program The program.
+ * @param from The index of the first instruction.
+ * @return The number of instructions of the block.
+ */
+size_t brainfuck_jit_block_length(const struct brainfuck_program *program,
+                                  size_t from) {
+  const struct brainfuck_instruction *code = program->instructions;
+  size_t length = 0;
+  while (from + length < program->size &&
+         (code[from + length].opcode == BRAINFUCK_OP_ADD ||
+          code[from + length].opcode == BRAINFUCK_OP_SET) &&
+         (int64_t)code[from + length].offset ==
+             (int64_t)code[from].offset + (int64_t)length) {
+    length += 1;
+  }
+  return length;
+}
+
+/**
+ * @brief Append a block of additions and assignments to consecutive cells,
+ * as SSE2 in 16 or 8 cells at a time: the cells are loaded, the assigned
+ * ones masked out, and the amounts added in one `paddb`, which wraps as
+ * every cell does. A block of nothing but assignments is only stored. The
+ * cells left over are done one at a time. The masks and amounts are kept
+ * inline and jumped over.
+ * @param code The machine code.
+ * @param block The instructions of the block, see
+ * `brainfuck_jit_block_length`.
+ * @param length The number of instructions, at least
+ * `BRAINFUCK_JIT_BLOCK_SIZE`.
+ * @param error The position of the error exit.
+ * @param checked Whether the cells are checked against the accessible
+ * memory. A block that is not wholly inside it, which may move or grow the
+ * tape or wrap around it, falls back to one cell at a time.
+ */
+void brainfuck_jit_emit_block(struct brainfuck_jit_code *code,
+                              const struct brainfuck_instruction *block,
+                              size_t length, size_t error, bool checked) {
+  size_t vector = length & ~(size_t)7;
+  const uint8_t jmp[] = {0xE9}; /* jmp rel32 over the constants */
+  brainfuck_jit_emit(code, jmp, sizeof(jmp));
+  size_t skip = code->size;
+  brainfuck_jit_emit_u32(code, 0);
+  size_t constants = code->size;
+  for (size_t k = 0; k < vector; k += 16) {
+    uint8_t mask[16] = {0};
+    uint8_t amounts[16] = {0};
+    for (size_t j = 0; j < 16 && k + j < vector; j += 1) {
+      mask[j] = block[k + j].opcode == BRAINFUCK_OP_ADD ? UINT8_MAX : 0;
+      amounts[j] = (uint8_t)block[k + j].argument;
+    }
+    brainfuck_jit_emit(code, mask, sizeof(mask));
+    brainfuck_jit_emit(code, amounts, sizeof(amounts));
+  }
+  uint32_t over = (uint32_t)(code->size - constants);
+  brainfuck_jit_patch_u32(code, skip, over);
+  brainfuck_jit_emit_index(code, block[0].offset, error, false);
+  size_t slow[2] = {0, 0};
+  if (checked) {
+    /* Both ends must be inside, since an index off the tape may wrap. */
+    const size_t size = offsetof(struct brainfuck_state, memory_size);
+    const uint8_t cmp_rax[] = {0x49, 0x3B, 0x86}; /* cmp rax, [r14+size] */
+    const uint8_t cmp_rdx[] = {0x49, 0x3B, 0x96}; /* cmp rdx, [r14+size] */
+    const uint8_t jae[] = {0x0F, 0x83};           /* jae rel32 */
+    const uint8_t lea_rdx[] = {0x48, 0x8D, 0x90}; /* lea rdx, [rax+d] */
+    brainfuck_jit_emit_field(code, cmp_rax, size);
+    brainfuck_jit_emit(code, jae, sizeof(jae));
+    slow[0] = code->size;
+    brainfuck_jit_emit_u32(code, 0);
+    brainfuck_jit_emit(code, lea_rdx, sizeof(lea_rdx));
+    brainfuck_jit_emit_u32(code, (uint32_t)(length - 1));
+    brainfuck_jit_emit_field(code, cmp_rdx, size);
+    brainfuck_jit_emit(code, jae, sizeof(jae));
+    slow[1] = code->size;
+    brainfuck_jit_emit_u32(code, 0);
+  }
+  for (size_t k = 0; k < vector; k += 16) {
+    bool wide = vector - k >= 16;
+    bool adds = false;
+    bool sets = false;
+    for (size_t j = k; j < k + (wide ? 16 : 8); j += 1) {
+      adds = adds || block[j].opcode == BRAINFUCK_OP_ADD;
+      sets = sets || block[j].opcode == BRAINFUCK_OP_SET;
+    }
+    size_t mask = constants + k * 2;
+    size_t amounts = mask + 16;
+    if (adds) {
+      /* movdqu xmm0, [rbx+rax+d] or movq xmm0, [rbx+rax+d] */
+      const uint8_t load[] = {0xF3, 0x0F, wide ? 0x6F : 0x7E, 0x84, 0x03};
+      brainfuck_jit_emit(code, load, sizeof(load));
+      brainfuck_jit_emit_u32(code, (uint32_t)k);
+    }
+    if (adds && sets) {
+      /* movdqu xmm1, [rip+mask]; pand xmm0, xmm1 */
+      const uint8_t load_mask[] = {0xF3, 0x0F, 0x6F, 0x0D};
+      brainfuck_jit_emit(code, load_mask, sizeof(load_mask));
+      brainfuck_jit_emit_u32(code, (uint32_t)(mask - (code->size + 4)));
+      const uint8_t pand[] = {0x66, 0x0F, 0xDB, 0xC1};
+      brainfuck_jit_emit(code, pand, sizeof(pand));
+    }
+    if (adds) {
+      /* movdqu xmm1, [rip+amounts]; paddb xmm0, xmm1 */
+      const uint8_t load_amounts[] = {0xF3, 0x0F, 0x6F, 0x0D};
+      brainfuck_jit_emit(code, load_amounts, sizeof(load_amounts));
+      brainfuck_jit_emit_u32(code, (uint32_t)(amounts - (code->size + 4)));
+      const uint8_t paddb[] = {0x66, 0x0F, 0xFC, 0xC1};
+      brainfuck_jit_emit(code, paddb, sizeof(paddb));
+    } else {
+      /* movdqu xmm0, [rip+amounts] */
+      const uint8_t load_amounts[] = {0xF3, 0x0F, 0x6F, 0x05};
+      brainfuck_jit_emit(code, load_amounts, sizeof(load_amounts));
+      brainfuck_jit_emit_u32(code, (uint32_t)(amounts - (code->size + 4)));
+    }
+    /* movdqu [rbx+rax+d], xmm0 or movq [rbx+rax+d], xmm0 */
+    const uint8_t store[] = {wide ? 0xF3 : 0x66, 0x0F, wide ? 0x7F : 0xD6,
+                             0x84, 0x03};
+    brainfuck_jit_emit(code, store, sizeof(store));
+    brainfuck_jit_emit_u32(code, (uint32_t)k);
+  }
+  for (size_t k = vector; k < length; k += 1) {
+    /* add byte [rbx+rax+d], imm8 or mov byte [rbx+rax+d], imm8 */
+    const uint8_t cell[] = {
+        block[k].opcode == BRAINFUCK_OP_ADD ? 0x80 : 0xC6, 0x84, 0x03};
+    brainfuck_jit_emit(code, cell, sizeof(cell));
+    brainfuck_jit_emit_u32(code, (uint32_t)k);
+    const uint8_t value[] = {(uint8_t)block[k].argument};
+    brainfuck_jit_emit(code, value, sizeof(value));
+  }
+  if (!checked) {
+    return;
+  }
+  brainfuck_jit_emit(code, jmp, sizeof(jmp));
+  size_t done = code->size;
+  brainfuck_jit_emit_u32(code, 0);
+  for (size_t i = 0; i < 2; i += 1) {
+    uint32_t forward = (uint32_t)(code->size - (slow[i] + 4));
+    brainfuck_jit_patch_u32(code, slow[i], forward);
+  }
+  for (size_t k = 0; k < length; k += 1) {
+    brainfuck_jit_emit_cell(code, &block[k], error, true);
+  }
+  uint32_t forward = (uint32_t)(code->size - (done + 4));
+  brainfuck_jit_patch_u32(code, done, forward);
+}
+
+/**
+ * @brief Read a byte from the input handler for JIT compiled code.
+ * @param context The context of IBF.
+ * @param cell The cell to read into.
+ * @param resume The index of the `,`, where a suspended run resumes.
+ * @return `SIZE_MAX` if the end of the input stops the program, or once the
+ * run is suspended.
+ */
+size_t brainfuck_jit_input(struct brainfuck_context *context, uint8_t *cell,
+                           size_t resume) {
+  if (brainfuck_input(context, cell)) {
+    return 0;
+  }
+  context->state->resume_pointer = resume;
+  return SIZE_MAX;
+}
+
+/**
+ * @brief Write a byte to the output handler for JIT compiled code.
+ * @param context The context of IBF.
+ * @param value The byte to write.
+ * @param count The number of times to write it.
+ * @param resume The index of the `.`, where a suspended run resumes.
+ * @return `SIZE_MAX` once the run is suspended.
+ */
+size_t brainfuck_jit_output(struct brainfuck_context *context, uint8_t value,
+                            uint32_t count, size_t resume) {
+  if (brainfuck_output_repeat(context, value, count)) {
+    return 0;
+  }
+  context->state->resume_pointer = resume;
+  return SIZE_MAX;
+}
+
+/**
+ * @brief Compile a program into x86-64 machine code. The memory buffer lives
+ * in `rbx`, the memory pointer in `r12`, the context in `r13`, the state in
+ * `r14` and the fuel in `rbp`. The code jumps to the entry in `rdx`, the
+ * code of the instruction a run starts or resumes at. A suspended run never
+ * resumes inside a block, which has no entry.
+ * @param state The state whose loop stack is used to resolve loops.
+ * @param code The machine code to append to.
+ * @param program The program to compile.
+ * @param checked Whether cells are checked against the accessible memory.
+ * @param entries Set to the position of the code of each instruction and of
+ * the end of the program, or UINT32_MAX for the ones inside a block.
+ * @return True if the program is compiled successfully, false if there is
+ * no memory for its code.
+ */
+bool brainfuck_jit_compile(struct brainfuck_state *state,
+                           struct brainfuck_jit_code *code,
+                           const struct brainfuck_program *program,
+                           bool checked, uint32_t *entries) {
+  /* push rbx; push r12; push r13; push r14; push rbp, which also aligns the
+   * stack for calls; mov r13, rdi; mov r14, rsi */
+  const uint8_t prologue[] = {0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56,
+                              0x55, 0x49, 0x89, 0xFD, 0x49, 0x89, 0xF6};
+  brainfuck_jit_emit(code, prologue, sizeof(prologue));
+  const uint8_t load_buffer[] = {0x49, 0x8B, 0x9E}; /* mov rbx, [r14+d] */
+  const uint8_t load_pointer[] = {0x4D, 0x8B, 0xA6}; /* mov r12, [r14+d] */
+  const uint8_t store_pointer[] = {0x4D, 0x89, 0xA6}; /* mov [r14+d], r12 */
+  const uint8_t load_fuel[] = {0x49, 0x8B, 0xAE};  /* mov rbp, [r14+d] */
+  const uint8_t store_fuel[] = {0x49, 0x89, 0xAE}; /* mov [r14+d], rbp */
+  const size_t buffer = offsetof(struct brainfuck_state, memory_buffer);
+  const size_t pointer = offsetof(struct brainfuck_state, memory_pointer);
+  const size_t fuel = offsetof(struct brainfuck_state, fuel);
+  brainfuck_jit_emit_field(code, load_buffer, buffer);
+  brainfuck_jit_emit_field(code, load_pointer, pointer);
+  brainfuck_jit_emit_field(code, load_fuel, fuel);
+  /* pop rbp; pop r14; pop r13; pop r12; pop rbx; ret */
+  const uint8_t epilogue[] = {0x5D, 0x41, 0x5E, 0x41, 0x5D,
+                              0x41, 0x5C, 0x5B, 0xC3};
+  /* Jump over the error exit, which every failed lookup jumps back to, to
+   * the entry: jmp rdx */
+  const uint8_t enter[] = {0xFF, 0xE2};
+  brainfuck_jit_emit(code, enter, sizeof(enter));
+  size_t error = code->size;
+  const uint8_t failure[] = {0x31, 0xC0}; /* xor eax, eax */
+  brainfuck_jit_emit(code, failure, sizeof(failure));
+  brainfuck_jit_emit_field(code, store_pointer, pointer);
+  brainfuck_jit_emit_field(code, store_fuel, fuel);
+  brainfuck_jit_emit(code, epilogue, sizeof(epilogue));
+  /* The positions of the jump displacements of unmatched loop starts. */
+  size_t *loop_stack =
+      brainfuck_state_reserve_loop_stack(state, program->max_depth);
+  if (loop_stack == NULL && program->max_depth > 0) {
+    return false;
+  }
+  size_t loop_stack_size = 0;
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    entries[i] = (uint32_t)code->size;
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+      case BRAINFUCK_OP_SET: {
+        size_t length = brainfuck_jit_block_length(program, i);
+        if (length >= BRAINFUCK_JIT_BLOCK_SIZE) {
+          brainfuck_jit_emit_block(code, instruction, length, error, checked);
+          for (size_t k = 1; k < length; k += 1) {
+            entries[i + k] = UINT32_MAX;
+          }
+          i += length - 1;
+          break;
+        }
+        brainfuck_jit_emit_cell(code, instruction, error, checked);
+        break;
+      }
+      case BRAINFUCK_OP_MOVE: {
+        brainfuck_jit_emit_index(code, instruction->argument, error, checked);
+        const uint8_t store[] = {0x49, 0x89, 0xC4}; /* mov r12, rax */
+        brainfuck_jit_emit(code, store, sizeof(store));
+        break;
+      }
+      case BRAINFUCK_OP_INPUT: {
+        /* mov rdi, r13; lea rsi, [rbx+r12]; mov edx, imm32 */
+        const uint8_t load[] = {0x4C, 0x89, 0xEF, 0x4A, 0x8D,
+                                0x34, 0x23, 0xBA};
+        brainfuck_jit_emit(code, load, sizeof(load));
+        brainfuck_jit_emit_u32(code, (uint32_t)i);
+        brainfuck_jit_emit_call(code, (uintptr_t)brainfuck_jit_input);
+        brainfuck_jit_emit_check(code, error);
+        break;
+      }
+      case BRAINFUCK_OP_OUTPUT: {
+        /* mov rdi, r13; movzx esi, byte [rbx+r12]; mov edx, imm32;
+         * mov ecx, imm32 */
+        const uint8_t load[] = {0x4C, 0x89, 0xEF, 0x42, 0x0F,
+                                0xB6, 0x34, 0x23, 0xBA};
+        brainfuck_jit_emit(code, load, sizeof(load));
+        brainfuck_jit_emit_u32(code, (uint32_t)instruction->argument);
+        const uint8_t load_resume[] = {0xB9};
+        brainfuck_jit_emit(code, load_resume, sizeof(load_resume));
+        brainfuck_jit_emit_u32(code, (uint32_t)i);
+        brainfuck_jit_emit_call(code, (uintptr_t)brainfuck_jit_output);
+        brainfuck_jit_emit_check(code, error);
+        break;
+      }
+      case BRAINFUCK_OP_LOOP_START: {
+        /* cmp byte [rbx+r12], 0; je rel32, patched at the loop end */
+        const uint8_t start[] = {0x42, 0x80, 0x3C, 0x23, 0x00, 0x0F, 0x84};
+        brainfuck_jit_emit(code, start, sizeof(start));
+        loop_stack[loop_stack_size] = code->size;
+        loop_stack_size += 1;
+        brainfuck_jit_emit_u32(code, 0);
+        break;
+      }
+      case BRAINFUCK_OP_LOOP_END: {
+        loop_stack_size -= 1;
+        size_t start = loop_stack[loop_stack_size];
+        /* cmp byte [rbx+r12], 0; je past the loop; dec rbp; jnz rel32 back
+         * to the loop body */
+        const uint8_t end[] = {0x42, 0x80, 0x3C, 0x23, 0x00, 0x74, 0x00,
+                               0x48, 0xFF, 0xCD, 0x0F, 0x85};
+        brainfuck_jit_emit(code, end, sizeof(end));
+        size_t skip = code->size - 5;
+        brainfuck_jit_emit_u32(code, (uint32_t)(start + 4 - (code->size + 4)));
+        /* Out of fuel: mov rdi, r14; mov esi, imm32; refill or suspend */
+        const uint8_t refill[] = {0x4C, 0x89, 0xF7, 0xBE};
+        brainfuck_jit_emit(code, refill, sizeof(refill));
+        brainfuck_jit_emit_u32(code, (uint32_t)instruction->argument + 1);
+        brainfuck_jit_emit_call(code, (uintptr_t)brainfuck_jit_refill);
+        brainfuck_jit_emit_check(code, error);
+        brainfuck_jit_emit_field(code, load_fuel, fuel);
+        const uint8_t jmp[] = {0xE9}; /* jmp rel32 back to the loop body */
+        brainfuck_jit_emit(code, jmp, sizeof(jmp));
+        brainfuck_jit_emit_u32(code, (uint32_t)(start + 4 - (code->size + 4)));
+        brainfuck_jit_patch_u8(code, skip - 1, (uint8_t)(code->size - skip));
+        uint32_t forward = (uint32_t)(code->size - (start + 4));
+        brainfuck_jit_patch_u32(code, start, forward);
+        break;
+      }
+      case BRAINFUCK_OP_MUL: {
+        /* The lookup may call out, so it comes before the load into ecx. */
+        brainfuck_jit_emit_index(code, instruction->offset, error, checked);
+        /* movzx ecx, byte [rbx+r12]; imul ecx, ecx, imm32 */
+        const uint8_t load[] = {0x42, 0x0F, 0xB6, 0x0C, 0x23, 0x69, 0xC9};
+        brainfuck_jit_emit(code, load, sizeof(load));
+        brainfuck_jit_emit_u32(code, (uint8_t)instruction->argument);
+        const uint8_t add[] = {0x00, 0x0C, 0x03}; /* add [rbx+rax], cl */
+        brainfuck_jit_emit(code, add, sizeof(add));
+        break;
+      }
+      case BRAINFUCK_OP_SCAN: {
+        /* The scan spends fuel too, so it is kept in the state meanwhile. */
+        brainfuck_jit_emit_field(code, store_fuel, fuel);
+        /* mov rdi, r14; mov rsi, r12; mov edx, imm32; mov ecx, imm32 */
+        const uint8_t load[] = {0x4C, 0x89, 0xF7, 0x4C, 0x89, 0xE6, 0xBA};
+        brainfuck_jit_emit(code, load, sizeof(load));
+        brainfuck_jit_emit_u32(code, (uint32_t)instruction->argument);
+        const uint8_t load_resume[] = {0xB9};
+        brainfuck_jit_emit(code, load_resume, sizeof(load_resume));
+        brainfuck_jit_emit_u32(code, (uint32_t)i);
+        brainfuck_jit_emit_call(code, (uintptr_t)brainfuck_jit_scan);
+        brainfuck_jit_emit_field(code, load_fuel, fuel);
+        brainfuck_jit_emit_check(code, error);
+        const uint8_t store[] = {0x49, 0x89, 0xC4}; /* mov r12, rax */
+        brainfuck_jit_emit(code, store, sizeof(store));
+        brainfuck_jit_emit_field(code, load_buffer, buffer);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  entries[program->size] = (uint32_t)code->size;
+  const uint8_t success[] = {0xB8, 0x01, 0x00, 0x00, 0x00}; /* mov eax, 1 */
+  brainfuck_jit_emit(code, success, sizeof(success));
+  brainfuck_jit_emit_field(code, store_pointer, pointer);
+  brainfuck_jit_emit_field(code, store_fuel, fuel);
+  brainfuck_jit_emit(code, epilogue, sizeof(epilogue));
+  return !code->failed;
+}
+
+/**
+ * @brief Check whether native code is the one of a program.
+ * @param native The native code.
+ * @param program The program.
+ * @param checked Whether cells are checked against the accessible memory.
+ * @return True if the native code compiles the program the same way.
+ */
+bool brainfuck_jit_native_matches(const struct brainfuck_jit_native *native,
+                                  const struct brainfuck_program *program,
+                                  bool checked) {
+  if (native->region == NULL || native->size != program->size ||
+      native->checked != checked) {
+    return false;
+  }
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *a = &native->instructions[i];
+    const struct brainfuck_instruction *b = &program->instructions[i];
+    if (a->opcode != b->opcode || a->offset != b->offset ||
+        a->argument != b->argument) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Find the native code of a program among the ones a context keeps,
+ * or compile it in place of the least recently run.
+ * @param context The context of IBF.
+ * @param program The program.
+ * @param checked Whether cells are checked against the accessible memory.
+ * @return The native code, or NULL if there is no memory for it.
+ */
+struct brainfuck_jit_native *brainfuck_jit_native_get(
+    struct brainfuck_context *context, const struct brainfuck_program *program,
+    bool checked) {
+  if (context->jit == NULL) {
+    context->jit = calloc(1, sizeof(struct brainfuck_jit_cache));
+    if (context->jit == NULL) {
+      return NULL;
+    }
+  }
+  struct brainfuck_jit_cache *cache = context->jit;
+  cache->clock += 1;
+  struct brainfuck_jit_native *native = &cache->natives[0];
+  for (size_t i = 0; i < BRAINFUCK_JIT_CACHE_SIZE; i += 1) {
+    if (brainfuck_jit_native_matches(&cache->natives[i], program, checked)) {
+      cache->natives[i].used = cache->clock;
+      return &cache->natives[i];
+    }
+    if (cache->natives[i].used < native->used) {
+      native = &cache->natives[i];
+    }
+  }
+  if (native->region != NULL) {
+    munmap(native->region, native->length);
+    native->region = NULL;
+  }
+  free(native->instructions);
+  free(native->entries);
+  native->instructions =
+      malloc(sizeof(struct brainfuck_instruction) * (program->size + 1));
+  native->entries = malloc(sizeof(uint32_t) * (program->size + 1));
+  struct brainfuck_jit_code code = {NULL, 0, 0, false};
+  if (native->instructions == NULL || native->entries == NULL ||
+      !brainfuck_jit_compile(context->state, &code, program, checked,
+                             native->entries)) {
+    free(code.bytes);
+    return NULL;
+  }
+  /* Write the code, then turn it executable, so that it is never both. */
+  void *region = mmap(NULL, code.size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    free(code.bytes);
+    return NULL;
+  }
+  memcpy(region, code.bytes, code.size);
+  free(code.bytes);
+  if (mprotect(region, code.size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(region, code.size);
+    return NULL;
+  }
+  memcpy(native->instructions, program->instructions,
+         sizeof(struct brainfuck_instruction) * program->size);
+  native->size = program->size;
+  native->checked = checked;
+  native->region = region;
+  native->length = code.size;
+  native->used = cache->clock;
+  return native;
+}
+#endif
+
+/**
+ * @brief Execute a compiled program of IBF as native code, compiled on its
+ * first run and kept by the context for the runs and resumptions after it.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @param checked Whether cells are checked, rather than left to fault in a
+ * guard of the tape, see `brainfuck_program_guarded`.
+ * @param success Set to whether the program is executed successfully.
+ * @return False if native code is not supported on this platform, in which
+ * case nothing is executed.
+ */
+bool brainfuck_program_execute_jit(struct brainfuck_context *context,
+                                   const struct brainfuck_program *program,
+                                   bool checked, bool *success) {
+#if defined(BRAINFUCK_JIT_X86_64)
+  if (context == NULL || program == NULL) {
+    return false;
+  }
+  sigjmp_buf jump;
+  if (!checked && !brainfuck_guard_enter(context->state, &jump)) {
+    checked = true;
+  }
+  struct brainfuck_jit_native *native =
+      brainfuck_jit_native_get(context, program, checked);
+  size_t resume = context->state->resume_pointer;
+  if (native == NULL || resume > program->size ||
+      native->entries[resume] == UINT32_MAX) {
+    brainfuck_guard_leave();
+    return false;
+  }
+  brainfuck_jit_function function;
+  /* Function and object pointers are not interchangeable in ISO C. */
+  memcpy(&function, &native->region, sizeof(function));
+  const uint8_t *entry = native->region + native->entries[resume];
+  if (checked) {
+    *success = function(context, context->state, entry);
+  } else if (sigsetjmp(jump, 0) == 0) {
+    *success = brainfuck_guard_check(context->state,
+                                     function(context, context->state, entry));
+  } else {
+    print_error_tape_out_of_range(context->state);
+    *success = false;
+  }
+  brainfuck_guard_leave();
+  return true;
+#else
+  (void)context;
+  (void)program;
+  (void)checked;
+  (void)success;
+  return false;
+#endif
+}
+
+/**
+ * @brief Run a compiled program of IBF with the engine in its options, from
+ * the instruction the state resumes at.
+ * @param context The context of IBF.
+ * @param program The program to run.
+ * @return True if the program is run to its end successfully.
+ */
+bool brainfuck_program_run(struct brainfuck_context *context,
+                           const struct brainfuck_program *program) {
+  /* Engines count the fuel down, so a run never starts without any. */
+  if (context->state->fuel == 0 && !brainfuck_budget_refill(context->state)) {
+    return false;
+  }
+  /* Skip the bounds checks where the guards of the tape catch every cell
+   * the program can run off to. */
+  bool checked = !brainfuck_program_guarded(context->state, program);
+  bool success = false;
+  switch (context->options.engine) {
+    case BRAINFUCK_ENGINE_SWITCH:
+      return brainfuck_program_execute_switch(context, program);
+    case BRAINFUCK_ENGINE_PROFILE:
+      return brainfuck_program_execute_profile(context, program);
+    case BRAINFUCK_ENGINE_JIT:
+      if (brainfuck_program_execute_jit(context, program, checked, &success)) {
+        return success;
+      }
+      /* Fall back to the threaded interpreter without native code. */
+      break;
+    case BRAINFUCK_ENGINE_THREADED:
+    default:
+      break;
+  }
+  return checked ? brainfuck_program_execute_threaded(context, program)
+                 : brainfuck_program_execute_threaded_unchecked(context,
+                                                                program);
+}
+
+/**
+ * @brief Execute a compiled program of IBF with the engine in its options.
+ * @param context The context of IBF.
+ * @param program The program to execute.
+ * @return True if the program is executed successfully. Once the budget of
+ * the context is spent, or once it waits for input or output without a
+ * handler, it returns false with the reason in `state->suspended`, and the
+ * run can go on with `brainfuck_program_resume`.
+ */
+bool brainfuck_program_execute(struct brainfuck_context *context,
+                               const struct brainfuck_program *program) {
+  if (context == NULL) {
+    return false;
+  }
+  context->state->resume_pointer = 0;
+  context->state->suspended = BRAINFUCK_SUSPEND_NONE;
+  context->state->output_pending = 0;
+  if (context->profile != NULL) {
+    brainfuck_profile_clear(context->profile);
+  }
+  context->state->stats.runs += 1;
+  uint64_t started = brainfuck_clock();
+  bool success = brainfuck_program_run(context, program);
+  context->state->stats.execute_time += brainfuck_clock() - started;
+  return success;
+}
+
+/**
+ * @brief Resume a suspended run of a compiled program of IBF, typically
+ * after giving it a new budget with `brainfuck_context_budget`, feeding it
+ * input or taking its output. The program must be the one that was
+ * suspended.
+ * @param context The context of IBF.
+ * @param program The program to resume.
+ * @return True if the program is executed to its end successfully, false if
+ * it fails, is suspended again, or was not suspended.
+ */
+bool brainfuck_program_resume(struct brainfuck_context *context,
+                              const struct brainfuck_program *program) {
+  if (context == NULL ||
+      context->state->suspended == BRAINFUCK_SUSPEND_NONE) {
+    return false;
+  }
+  context->state->suspended = BRAINFUCK_SUSPEND_NONE;
+  uint64_t started = brainfuck_clock();
+  bool success = brainfuck_program_run(context, program);
+  context->state->stats.execute_time += brainfuck_clock() - started;
+  return success;
+}
+
+/**
+ * @brief Find where the top-level instruction holding an instruction
+ * starts, so that every top-level instruction before it is whole.
+ * @param program The program of IBF.
+ * @param index The index of the instruction.
+ * @return The index of the top-level instruction.
+ */
+size_t brainfuck_fold_top(const struct brainfuck_program *program,
+                          size_t index) {
+  size_t top = 0;
+  size_t depth = 0;
+  for (size_t i = 0; i <= index && i < program->size; i += 1) {
+    if (depth == 0) {
+      top = i;
+    }
+    uint8_t opcode = program->instructions[i].opcode;
+    if (opcode == BRAINFUCK_OP_LOOP_START) {
+      depth += 1;
+    } else if (opcode == BRAINFUCK_OP_LOOP_END) {
+      depth -= 1;
+    }
+  }
+  return top;
+}
+
+/**
+ * @brief Take the output of a context running ahead of time and keep it.
+ * @param context The context of IBF, without an output handler.
+ * @param output The output kept so far.
+ * @return True if the output is kept, false if it cannot be allocated.
+ */
+bool brainfuck_fold_output(struct brainfuck_context *context,
+                           struct brainfuck_buffer *output) {
+  size_t length = 0;
+  const uint8_t *bytes = brainfuck_context_output(context, &length);
+  if (output->end + length > output->capacity) {
+    size_t capacity = output->capacity * 2;
+    if (capacity < output->end + length) {
+      capacity = output->end + length;
+    }
+    uint8_t *grown = realloc(output->bytes, capacity);
+    if (grown == NULL) {
+      return false;
+    }
+    output->bytes = grown;
+    output->capacity = capacity;
+  }
+  if (length > 0) {
+    memcpy(output->bytes + output->end, bytes, length);
+    output->end += length;
+  }
+  return true;
+}
+
+/**
+ * @brief Run the start of a program ahead of time, up to the top-level
+ * instruction that holds its first `,`, and replace that start with what it
+ * leaves behind: its output, the cells it sets and where it moves the
+ * pointer. A start that spends the budget, or writes more output than is
+ * worth keeping in the program, is folded up to the last top-level
+ * instruction it finishes, and one that fails, such as by running
+ * off the tape, is not folded at all, so that it fails when the program
+ * runs.
+ * @param program The program of IBF, optimized.
+ * @param options The options of the contexts the program will run on, whose
+ * `fold_steps` is the budget of the start.
+ * @return True if the program is folded or left as it is, false if the run
+ * ahead cannot be allocated.
+ */
+bool brainfuck_program_fold(struct brainfuck_program *program,
+                            const struct brainfuck_options *options) {
+  if (program == NULL || options->fold_steps == 0) {
+    return true;
+  }
+  size_t end = 0;
+  size_t depth = 0;
+  for (size_t i = 0; i < program->size; i += 1) {
+    uint8_t opcode = program->instructions[i].opcode;
+    if (opcode == BRAINFUCK_OP_INPUT) {
+      break;
+    }
+    if (opcode == BRAINFUCK_OP_LOOP_START) {
+      depth += 1;
+    } else if (opcode == BRAINFUCK_OP_LOOP_END) {
+      depth -= 1;
+    }
+    if (depth == 0) {
+      end = i + 1;
+    }
+  }
+  if (end == 0) {
+    return true;
+  }
+  struct brainfuck_options ahead = *options;
+  if (ahead.engine == BRAINFUCK_ENGINE_PROFILE) {
+    ahead.engine = BRAINFUCK_ENGINE_SWITCH;
+  }
+  ahead.max_steps = options->fold_steps;
+  ahead.timeout = 0;
+  struct brainfuck_context *context =
+      brainfuck_context_new(NULL, NULL, NULL, &ahead);
+  if (context == NULL) {
+    return false;
+  }
+  /* The start is run again when the program runs if it fails here, and
+   * reports its error then. */
+  struct brainfuck_state *state = context->state;
+  state->quiet = true;
+  struct brainfuck_buffer output = {NULL, 0, 0, 0};
+  bool success = true;
+  while (success && end > 0) {
+    struct brainfuck_program start = *program;
+    start.size = end;
+    start.sources = NULL;
+    output.end = 0;
+    bool finished = brainfuck_program_execute(context, &start);
+    while (!finished && state->suspended == BRAINFUCK_SUSPEND_OUTPUT &&
+           output.end <= BRAINFUCK_FOLD_OUTPUT_SIZE) {
+      if (!brainfuck_fold_output(context, &output)) {
+        break;
+      }
+      finished = brainfuck_program_resume(context, &start);
+    }
+    success = brainfuck_fold_output(context, &output);
+    if (finished) {
+      break;
+    }
+    bool full = output.end > BRAINFUCK_FOLD_OUTPUT_SIZE;
+    if (state->suspended != BRAINFUCK_SUSPEND_STEPS && !full) {
+      end = 0;
+      break;
+    }
+    /* Run again without the top-level loop the budget, or the room for the
+     * output, ran out in. */
+    end = brainfuck_fold_top(program, state->resume_pointer);
+    brainfuck_context_reset(context);
+    brainfuck_context_budget(context, options->fold_steps, 0);
+  }
+  size_t extent = 0;
+  for (size_t cell = 0; cell < state->memory_size; cell += 1) {
+    if (state->memory_buffer[cell] != 0) {
+      extent = cell + 1;
+    }
+  }
+  if (!success || end == 0 || extent > BRAINFUCK_MAX_DISTANCE ||
+      state->memory_pointer > BRAINFUCK_MAX_DISTANCE) {
+    free(output.bytes);
+    brainfuck_context_free(context);
+    return success;
+  }
+  /* The folded start writes its output from the first cell, then sets the
+   * cells from the initial pointer and moves to where the pointer ended. */
+  struct brainfuck_program *folded = brainfuck_program_new();
+  if (folded == NULL) {
+    free(output.bytes);
+    brainfuck_context_free(context);
+    return false;
+  }
+  folded->max_depth = program->max_depth;
+  for (size_t i = 0; success && i < output.end;) {
+    size_t run = 1;
+    while (i + run < output.end && output.bytes[i + run] == output.bytes[i] &&
+           run < INT32_MAX) {
+      run += 1;
+    }
+    success =
+        brainfuck_program_emit(folded, BRAINFUCK_OP_SET, 0, output.bytes[i]) &&
+        brainfuck_program_emit(folded, BRAINFUCK_OP_OUTPUT, 0, (int32_t)run);
+    i += run;
+  }
+  for (size_t cell = 0; success && cell < extent; cell += 1) {
+    if (state->memory_buffer[cell] != 0) {
+      success = brainfuck_program_emit(folded, BRAINFUCK_OP_SET, (int32_t)cell,
+                                       state->memory_buffer[cell]);
+    }
+  }
+  if (success && output.end > 0 && state->memory_buffer[0] == 0) {
+    success = brainfuck_program_emit(folded, BRAINFUCK_OP_SET, 0, 0);
+  }
+  if (success && state->memory_pointer != 0) {
+    success = brainfuck_program_emit(folded, BRAINFUCK_OP_MOVE, 0,
+                                     (int32_t)state->memory_pointer);
+  }
+  /* The rest of the program follows, with its loops moved along. */
+  size_t shift = folded->size;
+  for (size_t i = end; success && i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    int32_t argument = instruction->argument;
+    if (instruction->opcode == BRAINFUCK_OP_LOOP_START ||
+        instruction->opcode == BRAINFUCK_OP_LOOP_END) {
+      argument = (int32_t)((size_t)argument - end + shift);
+    }
+    success = brainfuck_program_emit(folded, instruction->opcode,
+                                     instruction->offset, argument);
+  }
+  /* What the start folds into points at the start of the source. */
+  if (success && program->sources != NULL) {
+    success = brainfuck_program_track(folded);
+    for (size_t i = 0; success && i < folded->size; i += 1) {
+      folded->sources[i] =
+          i < shift ? program->sources[0] : program->sources[i - shift + end];
+    }
+  }
+  if (success) {
+    struct brainfuck_program swapped = *program;
+    *program = *folded;
+    *folded = swapped;
+  }
+  brainfuck_program_free(folded);
+  free(output.bytes);
+  brainfuck_context_free(context);
+  return success;
+}
+
+bool brainfuck_loop_execute(struct brainfuck_context *context) {
+  if (context == NULL || context->state->loop_program.size == 0) {
+    return false;
+  }
+  struct brainfuck_state *state = context->state;
+  struct brainfuck_program *program = &state->loop_program;
+  /* The loop was compiled as it was typed, so it is ready to run. */
+  bool success =
+      state->memory_buffer[state->memory_pointer] == 0 ||
+      (brainfuck_optimize(state, program,
+                          context->options.optimization_level) &&
+       brainfuck_program_execute(context, program));
+  program->size = 0;
+  return success;
+}
+
+/**
+ * @brief Compile a token of a loop that is still open onto the loop program
+ * of the state, and run the loop once its outermost `]` is compiled.
+ * @param context The context of IBF.
+ * @param token The token of brainfuck code.
+ * @return True if the token is compiled and the loop, when closed, is
+ * executed successfully.
+ */
+bool brainfuck_loop_enque(struct brainfuck_context *context, char token) {
+  if (context == NULL) {
+    return false;
+  }
+  struct brainfuck_state *state = context->state;
+  struct brainfuck_program *program = &state->loop_program;
+  if (state->unmatched_depth == 0) {
+    program->size = 0;
+    program->max_depth = 0;
+  }
+  if (!brainfuck_compile_token(state, program, token,
+                               &state->unmatched_depth)) {
+    return false;
+  }
+  return state->unmatched_depth > 0 || brainfuck_loop_execute(context);
+}
+
+/**
+ * @brief Drop a loop that is still open, such as after an error inside it.
+ * @param context The context of IBF.
+ */
+void brainfuck_loop_discard(struct brainfuck_context *context) {
+  context->state->unmatched_depth = 0;
+  context->state->loop_program.size = 0;
+}
+
+/**
+ * @brief Tell whether every byte of a page is zero.
+ * @param bytes The bytes of the page.
+ * @param length The number of bytes, at least one.
+ * @return True if every byte is zero.
+ */
+bool brainfuck_snapshot_zero(const uint8_t *bytes, size_t length) {
+  return bytes[0] == 0 && memcmp(bytes, bytes + 1, length - 1) == 0;
+}
+
+/**
+ * @brief Free a snapshot of a context.
+ * @param snapshot The snapshot of IBF.
+ */
+void brainfuck_snapshot_free(struct brainfuck_snapshot *snapshot) {
+  if (snapshot == NULL) {
+    return;
+  }
+  if (snapshot->pages != NULL) {
+    for (size_t page = 0; page < snapshot->pages_size; page += 1) {
+      free(snapshot->pages[page]);
+    }
+  }
+  free(snapshot->pages);
+  free(snapshot->loop_stack);
+  free(snapshot->loop_program.instructions);
+  free(snapshot);
+}
+
+/**
+ * @brief Take a snapshot of the tape, the memory pointer and the open loop
+ * of a context. Only the pages of the tape that are not all zeros are
+ * copied, so that a snapshot of a large, mostly clear tape stays small.
+ * @param context The context of IBF.
+ * @return The snapshot, or NULL if it cannot be allocated.
+ */
+struct brainfuck_snapshot *brainfuck_snapshot_save(
+    const struct brainfuck_context *context) {
+  if (context == NULL) {
+    return NULL;
+  }
+  const struct brainfuck_state *state = context->state;
+  struct brainfuck_snapshot *snapshot =
+      calloc(1, sizeof(struct brainfuck_snapshot));
+  if (snapshot == NULL) {
+    return NULL;
+  }
+  size_t pages_size = (state->memory_size + BRAINFUCK_SNAPSHOT_PAGE_SIZE - 1) /
+                      BRAINFUCK_SNAPSHOT_PAGE_SIZE;
+  snapshot->pages = calloc(pages_size == 0 ? 1 : pages_size, sizeof(uint8_t *));
+  if (snapshot->pages == NULL) {
+    brainfuck_snapshot_free(snapshot);
+    return NULL;
+  }
+  snapshot->pages_size = pages_size;
+  for (size_t page = 0; page < pages_size; page += 1) {
+    size_t begin = page * BRAINFUCK_SNAPSHOT_PAGE_SIZE;
+    size_t length = state->memory_size - begin < BRAINFUCK_SNAPSHOT_PAGE_SIZE
+                        ? state->memory_size - begin
+                        : BRAINFUCK_SNAPSHOT_PAGE_SIZE;
+    const uint8_t *bytes = state->memory_buffer + begin;
+    if (brainfuck_snapshot_zero(bytes, length)) {
+      continue;
+    }
+    snapshot->pages[page] = malloc(length);
+    if (snapshot->pages[page] == NULL) {
+      brainfuck_snapshot_free(snapshot);
+      return NULL;
+    }
+    memcpy(snapshot->pages[page], bytes, length);
+  }
+  snapshot->memory_size = state->memory_size;
+  snapshot->memory_pointer = state->memory_pointer;
+  snapshot->unmatched_depth = state->unmatched_depth;
+  if (state->unmatched_depth > 0) {
+    snapshot->loop_stack = malloc(sizeof(size_t) * state->unmatched_depth);
+    if (snapshot->loop_stack == NULL) {
+      brainfuck_snapshot_free(snapshot);
+      return NULL;
+    }
+    memcpy(snapshot->loop_stack, state->loop_stack,
+           sizeof(size_t) * state->unmatched_depth);
+  }
+  if (state->loop_program.size > 0) {
+    snapshot->loop_program.instructions = malloc(
+        sizeof(struct brainfuck_instruction) * state->loop_program.size);
+    if (snapshot->loop_program.instructions == NULL) {
+      brainfuck_snapshot_free(snapshot);
+      return NULL;
+    }
+    memcpy(snapshot->loop_program.instructions,
+           state->loop_program.instructions,
+           sizeof(struct brainfuck_instruction) * state->loop_program.size);
+  }
+  snapshot->loop_program.size = state->loop_program.size;
+  snapshot->loop_program.capacity = state->loop_program.size;
+  snapshot->loop_program.max_depth = state->loop_program.max_depth;
+  return snapshot;
+}
+
+/**
+ * @brief Bring a context back to a snapshot taken of it. Only the pages of
+ * the tape that changed since are written, and the cells beyond the tape of
+ * the snapshot, if it grew, are cleared.
+ * @param context The context of IBF.
+ * @param snapshot The snapshot of IBF.
+ * @return True if restored successfully, false if the tape cannot hold the
+ * snapshot or the loop cannot be allocated, which leaves the context as it
+ * was.
+ */
+bool brainfuck_snapshot_restore(struct brainfuck_context *context,
+                                const struct brainfuck_snapshot *snapshot) {
+  if (context == NULL || snapshot == NULL) {
+    return false;
+  }
+  struct brainfuck_state *state = context->state;
+  if (snapshot->memory_size > state->memory_size &&
+      !brainfuck_tape_grow(state, snapshot->memory_size - 1)) {
+    return false;
+  }
+  if ((snapshot->unmatched_depth > 0 &&
+       brainfuck_state_reserve_loop_stack(state, snapshot->unmatched_depth) ==
+           NULL) ||
+      !brainfuck_program_reserve(&state->loop_program,
+                                 snapshot->loop_program.size)) {
+    return false;
+  }
+  for (size_t begin = 0; begin < state->memory_size;
+       begin += BRAINFUCK_SNAPSHOT_PAGE_SIZE) {
+    size_t page = begin / BRAINFUCK_SNAPSHOT_PAGE_SIZE;
+    size_t length = state->memory_size - begin < BRAINFUCK_SNAPSHOT_PAGE_SIZE
+                        ? state->memory_size - begin
+                        : BRAINFUCK_SNAPSHOT_PAGE_SIZE;
+    uint8_t *bytes = state->memory_buffer + begin;
+    size_t kept = 0;
+    if (page < snapshot->pages_size && snapshot->pages[page] != NULL) {
+      kept = snapshot->memory_size - begin < length
+                 ? snapshot->memory_size - begin
+                 : length;
+      if (memcmp(bytes, snapshot->pages[page], kept) != 0) {
+        memcpy(bytes, snapshot->pages[page], kept);
+      }
+    }
+    /* A page that is still clear is not written, so that it stays shared. */
+    if (kept < length &&
+        !brainfuck_snapshot_zero(bytes + kept, length - kept)) {
+      memset(bytes + kept, 0, length - kept);
+    }
+  }
+  state->memory_pointer = snapshot->memory_pointer;
+  state->unmatched_depth = snapshot->unmatched_depth;
+  if (snapshot->unmatched_depth > 0) {
+    memcpy(state->loop_stack, snapshot->loop_stack,
+           sizeof(size_t) * snapshot->unmatched_depth);
+  }
+  if (snapshot->loop_program.size > 0) {
+    memcpy(state->loop_program.instructions,
+           snapshot->loop_program.instructions,
+           sizeof(struct brainfuck_instruction) * snapshot->loop_program.size);
+  }
+  state->loop_program.size = snapshot->loop_program.size;
+  state->loop_program.max_depth = snapshot->loop_program.max_depth;
+  return true;
+}
+
+/**
+ * @brief Execute a line of brainfuck code. A line cannot be resumed, so a
+ * context without handlers fails where its run would be suspended.
+ * @param context The context of IBF.
+ * @param src A line of brainfuck code to execute.
+ * @return True if the line is executed successfully, false otherwise.
+ */
+bool brainfuck_main(struct brainfuck_context *context, char *src) {
+  if (context == NULL || src == NULL) {
+    return false;
+  }
+  for (size_t i = 0; src[i] != '\0'; i += 1) {
+    /* Once a loop is open, every token is compiled until it is closed. */
+    if (context->state->unmatched_depth > 0) {
+      if (!brainfuck_loop_enque(context, src[i])) {
+        brainfuck_loop_discard(context);
+        return false;
+      }
+      continue;
+    }
+    /* If the unmatched depth is 0, we can execute the instruction. */
+    switch (src[i]) {
+      case BRAINFUCK_TOKEN_PLUS:
+        brainfuck_execute_plus(context);
+        break;
+      case BRAINFUCK_TOKEN_MINUS:
+        brainfuck_execute_minus(context);
+        break;
+      case BRAINFUCK_TOKEN_PREVIOUS:
+        if (!brainfuck_execute_previous(context)) {
+          return false;
+        }
+        break;
+      case BRAINFUCK_TOKEN_NEXT:
+        if (!brainfuck_execute_next(context)) {
+          return false;
+        }
+        break;
+      case BRAINFUCK_TOKEN_INPUT:
+        if (!brainfuck_execute_input(context)) {
+          return false;
+        }
+        break;
+      case BRAINFUCK_TOKEN_OUTPUT:
+        if (!brainfuck_execute_output(context)) {
+          return false;
+        }
+        break;
+      case BRAINFUCK_TOKEN_LOOP_START:
+        if (!brainfuck_loop_enque(context, src[i])) {
+          brainfuck_loop_discard(context);
+          return false;
+        }
+        break;
+      case BRAINFUCK_TOKEN_LOOP_END:
+        print_error_unmatched_loop_end();
+        return false;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Write a compiled program as a standalone C translation unit with
+ * the same fixed memory tape and wraparound as IBF.
+ * @param stream The stream to write to.
+ * @param program The program to translate.
+ * @param size The number of cells of the memory tape.
+ * @param eof What `,` does at the end of the input, see `enum brainfuck_eof`.
+ */
+void brainfuck_emit_c(FILE *stream, const struct brainfuck_program *program,
+                      size_t size, uint8_t eof) {
+  const char *at_eof = eof == BRAINFUCK_EOF_UNCHANGED ? "return;"
+                       : eof == BRAINFUCK_EOF_ZERO    ? "c = 0;"
+                       : eof == BRAINFUCK_EOF_MAX     ? "c = 255;"
+                                                      : "exit(EXIT_FAILURE);";
+  /* Only the helpers the program uses are written, so that the translation
+   * compiles without warnings. */
+  bool moves = false;
+  bool reads = false;
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+        moves = moves || instruction->offset != 0;
+        break;
+      case BRAINFUCK_OP_MOVE:
+      case BRAINFUCK_OP_SET:
+      case BRAINFUCK_OP_MUL:
+      case BRAINFUCK_OP_SCAN:
+        moves = true;
+        break;
+      case BRAINFUCK_OP_INPUT:
+        reads = true;
+        break;
+      default:
+        break;
+    }
+  }
+  fprintf(stream, "/* Generated by IBF %d.%d.%d. */\n", IBF_VERSION_MAJOR,
+          IBF_VERSION_MINOR, IBF_VERSION_PATCH);
+  fprintf(stream,
+          "#include <stddef.h>\n"
+          "#include <stdint.h>\n"
+          "#include <stdio.h>\n"
+          "#include <stdlib.h>\n"
+          "\n"
+          "#define MEMORY_SIZE ((size_t)%zu)\n"
+          "\n",
+          size);
+  if (program->size > 0) {
+    fprintf(stream, "static uint8_t memory[MEMORY_SIZE];\n\n");
+  }
+  if (moves) {
+    fprintf(stream,
+            "static size_t at(size_t pointer, ptrdiff_t offset) {\n"
+            "  size_t index = pointer + (size_t)offset;\n"
+            "  if (index >= MEMORY_SIZE) {\n"
+            "    ptrdiff_t wrapped =\n"
+            "        ((ptrdiff_t)pointer + offset) %% (ptrdiff_t)MEMORY_SIZE;\n"
+            "    index = (size_t)wrapped + (wrapped < 0 ? MEMORY_SIZE : 0);\n"
+            "  }\n"
+            "  return index;\n"
+            "}\n"
+            "\n");
+  }
+  if (reads) {
+    fprintf(stream,
+            "static void input(uint8_t *cell) {\n"
+            "  int c = getchar();\n"
+            "  if (c == EOF) {\n"
+            "    %s\n"
+            "  }\n"
+            "  *cell = (uint8_t)c;\n"
+            "}\n"
+            "\n",
+            at_eof);
+  }
+  fprintf(stream, "int main(void) {\n");
+  if (program->size > 0) {
+    fprintf(stream, "  size_t p = 0;\n");
+  }
+  size_t depth = 1;
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    if (instruction->opcode == BRAINFUCK_OP_LOOP_END) {
+      depth -= 1;
+    }
+    fprintf(stream, "%*s", (int)depth * 2, "");
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+        if (instruction->offset == 0) {
+          fprintf(stream, "memory[p] += %d;\n", instruction->argument);
+        } else {
+          fprintf(stream, "memory[at(p, %d)] += %d;\n", instruction->offset,
+                  instruction->argument);
+        }
+        break;
+      case BRAINFUCK_OP_MOVE:
+        fprintf(stream, "p = at(p, %d);\n", instruction->argument);
+        break;
+      case BRAINFUCK_OP_INPUT:
+        fprintf(stream, "input(&memory[p]);\n");
+        break;
+      case BRAINFUCK_OP_OUTPUT:
+        if (instruction->argument == 1) {
+          fprintf(stream, "putchar(memory[p]);\n");
+        } else {
+          fprintf(stream,
+                  "for (int i = 0; i < %d; i += 1) putchar(memory[p]);\n",
+                  instruction->argument);
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_START:
+        fprintf(stream, "while (memory[p] != 0) {\n");
+        depth += 1;
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        fprintf(stream, "}\n");
+        break;
+      case BRAINFUCK_OP_SET:
+        fprintf(stream, "memory[at(p, %d)] = %d;\n", instruction->offset,
+                instruction->argument);
+        break;
+      case BRAINFUCK_OP_MUL:
+        fprintf(stream, "memory[at(p, %d)] += memory[p] * %d;\n",
+                instruction->offset, instruction->argument);
+        break;
+      case BRAINFUCK_OP_SCAN:
+        fprintf(stream, "while (memory[p] != 0) p = at(p, %d);\n",
+                instruction->argument);
+        break;
+      default:
+        break;
+    }
+  }
+  fprintf(stream,
+          "  fflush(stdout);\n"
+          "  return EXIT_SUCCESS;\n"
+          "}\n");
+}
+
+/**
+ * @brief Write the x86-64 assembly that moves `rax` to the wrapped index of
+ * the cell at an offset, as `at` does in the emitted C. The size of the tape
+ * lives in `r13`, and `.Lwrap` wraps the indices outside of it.
+ * @param stream The stream to write to.
+ * @param offset The offset of the cell.
+ * @param label A unique number for the local label.
+ */
+void brainfuck_emit_asm_index(FILE *stream, int32_t offset, size_t label) {
+  fprintf(stream,
+          "  lea rax, [r12 + %d]\n"
+          "  cmp rax, r13\n"
+          "  jb .Lindex%zu\n"
+          "  call .Lwrap\n"
+          ".Lindex%zu:\n",
+          offset, label, label);
+}
+
+/**
+ * @brief Write a compiled program as x86-64 assembly for the GNU assembler,
+ * which defines `main` on top of the C library. As in the JIT compiler, the
+ * tape is in `rbx` and the memory pointer in `r12`, but `r13` holds the size
+ * of the tape and `r14` counts down runs of `.`, since there is no context
+ * or state.
+ * @param stream The stream to write to.
+ * @param program The program to translate.
+ * @param size The number of cells of the memory tape.
+ * @param eof What `,` does at the end of the input, see `enum brainfuck_eof`.
+ */
+void brainfuck_emit_asm(FILE *stream, const struct brainfuck_program *program,
+                        size_t size, uint8_t eof) {
+  const char *at_eof = eof == BRAINFUCK_EOF_UNCHANGED ? "  jmp .Lread%zu\n"
+                       : eof == BRAINFUCK_EOF_ZERO    ? "  xor eax, eax\n"
+                       : eof == BRAINFUCK_EOF_MAX     ? "  mov eax, 255\n"
+                                                      : "  mov edi, 1\n"
+                                                        "  call exit@PLT\n";
+  fprintf(stream, "# Generated by IBF %d.%d.%d.\n", IBF_VERSION_MAJOR,
+          IBF_VERSION_MINOR, IBF_VERSION_PATCH);
+  fprintf(stream,
+          "  .intel_syntax noprefix\n"
+          "  .text\n"
+          "  .globl main\n"
+          "main:\n"
+          "  push rbx\n"
+          "  push r12\n"
+          "  push r13\n"
+          "  push r14\n"
+          "  push r15\n"
+          "  lea rbx, [rip + memory]\n"
+          "  xor r12d, r12d\n"
+          "  movabs r13, %zu\n",
+          size);
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+        if (instruction->offset == 0) {
+          fprintf(stream, "  add byte ptr [rbx + r12], %d\n",
+                  instruction->argument);
+          break;
+        }
+        brainfuck_emit_asm_index(stream, instruction->offset, i);
+        fprintf(stream, "  add byte ptr [rbx + rax], %d\n",
+                instruction->argument);
+        break;
+      case BRAINFUCK_OP_MOVE:
+        brainfuck_emit_asm_index(stream, instruction->argument, i);
+        fprintf(stream, "  mov r12, rax\n");
+        break;
+      case BRAINFUCK_OP_INPUT:
+        fprintf(stream,
+                "  call getchar@PLT\n"
+                "  cmp eax, -1\n"
+                "  jne .Linput%zu\n",
+                i);
+        fprintf(stream, at_eof, i);
+        fprintf(stream,
+                ".Linput%zu:\n"
+                "  mov byte ptr [rbx + r12], al\n"
+                ".Lread%zu:\n",
+                i, i);
+        break;
+      case BRAINFUCK_OP_OUTPUT:
+        if (instruction->argument == 1) {
+          fprintf(stream,
+                  "  movzx edi, byte ptr [rbx + r12]\n"
+                  "  call putchar@PLT\n");
+          break;
+        }
+        /* A run of writes counts down in r14. */
+        fprintf(stream,
+                "  mov r14d, %d\n"
+                ".Loutput%zu:\n"
+                "  movzx edi, byte ptr [rbx + r12]\n"
+                "  call putchar@PLT\n"
+                "  dec r14d\n"
+                "  jnz .Loutput%zu\n",
+                instruction->argument, i, i);
+        break;
+      case BRAINFUCK_OP_LOOP_START:
+        fprintf(stream,
+                "  cmp byte ptr [rbx + r12], 0\n"
+                "  je .Lend%d\n"
+                ".Lbody%zu:\n",
+                instruction->argument, i);
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        fprintf(stream,
+                "  cmp byte ptr [rbx + r12], 0\n"
+                "  jne .Lbody%d\n"
+                ".Lend%zu:\n",
+                instruction->argument, i);
+        break;
+      case BRAINFUCK_OP_SET:
+        brainfuck_emit_asm_index(stream, instruction->offset, i);
+        fprintf(stream, "  mov byte ptr [rbx + rax], %d\n",
+                instruction->argument);
+        break;
+      case BRAINFUCK_OP_MUL:
+        fprintf(stream,
+                "  movzx ecx, byte ptr [rbx + r12]\n"
+                "  imul ecx, ecx, %d\n",
+                instruction->argument);
+        brainfuck_emit_asm_index(stream, instruction->offset, i);
+        fprintf(stream, "  add byte ptr [rbx + rax], cl\n");
+        break;
+      case BRAINFUCK_OP_SCAN:
+        fprintf(stream,
+                ".Lscan%zu:\n"
+                "  cmp byte ptr [rbx + r12], 0\n"
+                "  je .Lscanned%zu\n",
+                i, i);
+        brainfuck_emit_asm_index(stream, instruction->argument, i);
+        fprintf(stream,
+                "  mov r12, rax\n"
+                "  jmp .Lscan%zu\n"
+                ".Lscanned%zu:\n",
+                i, i);
+        break;
+      default:
+        break;
+    }
+  }
+  fprintf(stream,
+          "  mov rdi, qword ptr [rip + stdout]\n"
+          "  call fflush@PLT\n"
+          "  xor eax, eax\n"
+          "  pop r15\n"
+          "  pop r14\n"
+          "  pop r13\n"
+          "  pop r12\n"
+          "  pop rbx\n"
+          "  ret\n"
+          ".Lwrap:\n"
+          "  cqo\n"
+          "  idiv r13\n"
+          "  mov rax, rdx\n"
+          "  test rax, rax\n"
+          "  jns .Lwrapped\n"
+          "  add rax, r13\n"
+          ".Lwrapped:\n"
+          "  ret\n"
+          "  .bss\n"
+          "memory:\n"
+          "  .zero %zu\n"
+          "  .section .note.GNU-stack,\"\",@progbits\n",
+          size);
+}
+
+/**
+ * @brief The names of the opcodes in a profile.
+ */
+static const char *const brainfuck_opcode_names[BRAINFUCK_OPCODE_COUNT] = {
+    [BRAINFUCK_OP_ADD] = "add",
+    [BRAINFUCK_OP_MOVE] = "move",
+    [BRAINFUCK_OP_INPUT] = "input",
+    [BRAINFUCK_OP_OUTPUT] = "output",
+    [BRAINFUCK_OP_LOOP_START] = "loop start",
+    [BRAINFUCK_OP_LOOP_END] = "loop end",
+    [BRAINFUCK_OP_SET] = "set",
+    [BRAINFUCK_OP_MUL] = "mul",
+    [BRAINFUCK_OP_SCAN] = "scan",
+};
+
+/**
+ * @brief Rank the instructions of an opcode by a count of a profile.
+ * @param program The program of the profile.
+ * @param size The instructions counted.
+ * @param opcode The opcode of the instructions to rank.
+ * @param keys The count of each instruction, ranked from the highest.
+ * @param ranked Set to up to `BRAINFUCK_PROFILE_LOOPS` indexes of
+ * instructions with a count above zero.
+ * @return The number of ranked instructions.
+ */
+size_t brainfuck_profile_rank(const struct brainfuck_program *program,
+                              size_t size, uint8_t opcode,
+                              const uint64_t *keys, size_t *ranked) {
+  size_t count = 0;
+  for (size_t i = 0; i < size; i += 1) {
+    if (program->instructions[i].opcode != opcode || keys[i] == 0) {
+      continue;
+    }
+    size_t rank = count;
+    while (rank > 0 && keys[ranked[rank - 1]] < keys[i]) {
+      rank -= 1;
+    }
+    if (rank == BRAINFUCK_PROFILE_LOOPS) {
+      continue;
+    }
+    if (count < BRAINFUCK_PROFILE_LOOPS) {
+      count += 1;
+    }
+    memmove(&ranked[rank + 1], &ranked[rank],
+            sizeof(size_t) * (count - 1 - rank));
+    ranked[rank] = i;
+  }
+  return count;
+}
+
+/**
+ * @brief Write a loop of a profile as a row of a table.
+ * @param stream The stream to write to.
+ * @param profile The profile of IBF.
+ * @param program The program of the profile.
+ * @param start The index of the loop start.
+ */
+void brainfuck_profile_report_loop(FILE *stream,
+                                   const struct brainfuck_profile *profile,
+                                   const struct brainfuck_program *program,
+                                   size_t start) {
+  size_t end = (size_t)program->instructions[start].argument;
+  fprintf(stream, "  %12zu %12llu %16llu ",
+          program->sources != NULL ? program->sources[start] : start,
+          (unsigned long long)profile->counts[start],
+          (unsigned long long)profile->counts[end]);
+  if (profile->times[start] > 0) {
+    fprintf(stream, "%12.3f\n", (double)profile->times[start] / 1e6);
+  } else {
+    fprintf(stream, "%12s\n", "-");
+  }
+}
+
+/**
+ * @brief Write the sequences of two or three opcodes that a profile counted
+ * running one after the other most often, which are the candidates for
+ * superinstructions, see `make superinstructions`.
+ * @param stream The stream to write to.
+ * @param profile The profile of IBF.
+ * @param program The program of the profile.
+ * @param size The instructions counted.
+ * @param total The instructions executed.
+ */
+void brainfuck_profile_report_sequences(FILE *stream,
+                                        const struct brainfuck_profile *profile,
+                                        const struct brainfuck_program *program,
+                                        size_t size, uint64_t total) {
+  enum { count = BRAINFUCK_OPCODE_COUNT };
+  uint64_t *pairs = calloc(count * count + count * count * count,
+                           sizeof(uint64_t));
+  if (pairs == NULL) {
+    return;
+  }
+  uint64_t *triples = pairs + count * count;
+  const struct brainfuck_instruction *code = program->instructions;
+  for (size_t i = 0; i + 1 < size; i += 1) {
+    pairs[code[i].opcode * count + code[i + 1].opcode] += profile->follows[i];
+    if (i + 2 < size) {
+      triples[(code[i].opcode * count + code[i + 1].opcode) * count +
+              code[i + 2].opcode] += profile->chains[i];
+    }
+  }
+  /* Rank both by the instructions they cover, pairs first on a tie. */
+  size_t ranked[BRAINFUCK_PROFILE_SEQUENCES];
+  uint64_t covered[BRAINFUCK_PROFILE_SEQUENCES];
+  size_t ranks = 0;
+  for (size_t key = 0; key < count * count + count * count * count;
+       key += 1) {
+    uint64_t instructions = pairs[key] * (key < count * count ? 2 : 3);
+    size_t rank = ranks;
+    while (rank > 0 && covered[rank - 1] < instructions) {
+      rank -= 1;
+    }
+    if (instructions == 0 || rank == BRAINFUCK_PROFILE_SEQUENCES) {
+      continue;
+    }
+    if (ranks < BRAINFUCK_PROFILE_SEQUENCES) {
+      ranks += 1;
+    }
+    memmove(&ranked[rank + 1], &ranked[rank],
+            sizeof(size_t) * (ranks - 1 - rank));
+    memmove(&covered[rank + 1], &covered[rank],
+            sizeof(uint64_t) * (ranks - 1 - rank));
+    ranked[rank] = key;
+    covered[rank] = instructions;
+  }
+  if (ranks > 0) {
+    fprintf(stream, "Hottest sequences:\n  %20s %7s  %s\n", "executions",
+            "share", "opcodes");
+  }
+  for (size_t rank = 0; rank < ranks; rank += 1) {
+    size_t key = ranked[rank];
+    bool pair = key < count * count;
+    fprintf(stream, "  %20llu %6.2f%%  ", (unsigned long long)pairs[key],
+            100.0 * (double)covered[rank] / (double)total);
+    if (!pair) {
+      key -= count * count;
+      fprintf(stream, "%s + ", brainfuck_opcode_names[key / count / count]);
+    }
+    fprintf(stream, "%s + %s\n", brainfuck_opcode_names[key / count % count],
+            brainfuck_opcode_names[key % count]);
+  }
+  free(pairs);
+}
+
+/**
+ * @brief Write what a profile counted for a program: the executions of
+ * every opcode and of the sequences that ran most often, the loops that
+ * iterated the most and the top-level loops that took the longest with
+ * their source offsets, then a histogram of the accesses to the cells
+ * touched.
+ * @param stream The stream to write to.
+ * @param profile The profile of a run of the program.
+ * @param program The program, whose instruction indexes are shown instead of
+ * source offsets if it does not track them.
+ */
+void brainfuck_profile_report(FILE *stream,
+                              const struct brainfuck_profile *profile,
+                              const struct brainfuck_program *program) {
+  size_t size = program->size < profile->size ? program->size : profile->size;
+  uint64_t opcodes[BRAINFUCK_OPCODE_COUNT] = {0};
+  uint64_t total = 0;
+  for (size_t i = 0; i < size; i += 1) {
+    opcodes[program->instructions[i].opcode] += profile->counts[i];
+    total += profile->counts[i];
+  }
+  fprintf(stream, "Profile: %llu instructions executed.\n",
+          (unsigned long long)total);
+  for (size_t opcode = 0; opcode < BRAINFUCK_OPCODE_COUNT; opcode += 1) {
+    if (opcodes[opcode] > 0) {
+      fprintf(stream, "  %-12s %20llu %6.2f%%\n",
+              brainfuck_opcode_names[opcode],
+              (unsigned long long)opcodes[opcode],
+              100.0 * (double)opcodes[opcode] / (double)total);
+    }
+  }
+  brainfuck_profile_report_sequences(stream, profile, program, size, total);
+  /* Loops iterate as often as their ends run, and only those at the top
+   * level are timed. */
+  size_t loops[BRAINFUCK_PROFILE_LOOPS];
+  const char *heading = program->sources != NULL ? "source" : "instruction";
+  size_t count = brainfuck_profile_rank(program, size, BRAINFUCK_OP_LOOP_END,
+                                        profile->counts, loops);
+  if (count > 0) {
+    fprintf(stream, "Hottest loops:\n  %12s %12s %16s %12s\n", heading,
+            "reached", "iterations", "time (ms)");
+  }
+  for (size_t rank = 0; rank < count; rank += 1) {
+    brainfuck_profile_report_loop(
+        stream, profile, program,
+        (size_t)program->instructions[loops[rank]].argument);
+  }
+  count = brainfuck_profile_rank(program, size, BRAINFUCK_OP_LOOP_START,
+                                 profile->times, loops);
+  if (count > 0) {
+    fprintf(stream, "Slowest top-level loops:\n  %12s %12s %16s %12s\n",
+            heading, "reached", "iterations", "time (ms)");
+  }
+  for (size_t rank = 0; rank < count; rank += 1) {
+    brainfuck_profile_report_loop(stream, profile, program, loops[rank]);
+  }
+  /* Spread the touched cells over the rows of the histogram. */
+  size_t lowest = SIZE_MAX;
+  size_t highest = 0;
+  size_t touched = 0;
+  uint64_t accesses = 0;
+  for (size_t i = 0; i < profile->cells_size; i += 1) {
+    if (profile->cells[i] > 0) {
+      lowest = i < lowest ? i : lowest;
+      highest = i;
+      touched += 1;
+      accesses += profile->cells[i];
+    }
+  }
+  if (touched == 0) {
+    return;
+  }
+  fprintf(stream, "Cells touched: %zu from %zu to %zu, %llu accesses.\n",
+          touched, lowest, highest, (unsigned long long)accesses);
+  size_t span = highest - lowest + 1;
+  size_t rows = span < BRAINFUCK_PROFILE_ROWS ? span : BRAINFUCK_PROFILE_ROWS;
+  size_t width = (span + rows - 1) / rows;
+  uint64_t buckets[BRAINFUCK_PROFILE_ROWS] = {0};
+  uint64_t busiest = 0;
+  for (size_t i = lowest; i <= highest; i += 1) {
+    size_t row = (i - lowest) / width;
+    buckets[row] += profile->cells[i];
+    busiest = buckets[row] > busiest ? buckets[row] : busiest;
+  }
+  for (size_t row = 0; row * width < span; row += 1) {
+    size_t first = lowest + row * width;
+    size_t last = first + width - 1 < highest ? first + width - 1 : highest;
+    int bar = (int)(buckets[row] * BRAINFUCK_PROFILE_BAR / busiest);
+    fprintf(stream, "  %10zu-%-10zu %20llu %.*s\n", first, last,
+            (unsigned long long)buckets[row], bar,
+            "########################################");
+  }
+}
+
+/**
+ * @brief Hash bytes eight at a time, to key compiled programs by their
+ * source. It is fast rather than cryptographic.
+ * @param data The bytes to hash.
+ * @param length The number of bytes.
+ * @param seed The seed, or the hash of what comes before the bytes.
+ * @return The hash.
+ */
+uint64_t brainfuck_hash(const void *data, size_t length, uint64_t seed) {
+  const uint8_t *bytes = data;
+  uint64_t hash = seed ^ (length * UINT64_C(0x9E3779B97F4A7C15));
+  uint64_t word = 0;
+  size_t i = 0;
+  for (; i + sizeof(word) <= length; i += sizeof(word)) {
+    memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * UINT64_C(0xFF51AFD7ED558CCD);
+    hash ^= hash >> 32;
+  }
+  word = 0;
+  memcpy(&word, bytes + i, length - i);
+  hash = (hash ^ word) * UINT64_C(0xFF51AFD7ED558CCD);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xC4CEB9FE1A85EC53);
+  return hash ^ (hash >> 33);
+}
+
+/**
+ * @brief Check that a program read from a file is one the compiler could
+ * have produced, so that a damaged file cannot make an engine misbehave.
+ * @param state The state whose loop stack is used to match loops.
+ * @param program The program to check.
+ * @return True if the program is well formed.
+ */
+bool brainfuck_program_validate(struct brainfuck_state *state,
+                                const struct brainfuck_program *program) {
+  if (program->size > BRAINFUCK_MAX_PROGRAM_SIZE ||
+      program->max_depth > BRAINFUCK_MAX_LOOP_DEPTH) {
+    return false;
+  }
+  size_t *loop_stack =
+      brainfuck_state_reserve_loop_stack(state, program->max_depth);
+  if (loop_stack == NULL && program->max_depth > 0) {
+    return false;
+  }
+  size_t loop_stack_size = 0;
+  for (size_t i = 0; i < program->size; i += 1) {
+    const struct brainfuck_instruction *instruction = &program->instructions[i];
+    int32_t argument = instruction->argument;
+    bool valid = instruction->offset >= -BRAINFUCK_MAX_DISTANCE &&
+                 instruction->offset <= BRAINFUCK_MAX_DISTANCE;
+    switch (instruction->opcode) {
+      case BRAINFUCK_OP_ADD:
+      case BRAINFUCK_OP_SET:
+      case BRAINFUCK_OP_MUL:
+        valid = valid && argument >= 0 && argument <= UINT8_MAX;
+        break;
+      case BRAINFUCK_OP_MOVE:
+      case BRAINFUCK_OP_SCAN:
+        valid = valid && argument != 0 &&
+                argument >= -BRAINFUCK_MAX_DISTANCE &&
+                argument <= BRAINFUCK_MAX_DISTANCE;
+        break;
+      case BRAINFUCK_OP_INPUT:
+        break;
+      case BRAINFUCK_OP_OUTPUT:
+        valid = valid && argument > 0;
+        break;
+      case BRAINFUCK_OP_LOOP_START:
+        /* The matching end is checked when it is reached. */
+        valid = valid && loop_stack_size < program->max_depth &&
+                argument > 0 && (size_t)argument > i &&
+                (size_t)argument < program->size;
+        if (valid) {
+          loop_stack[loop_stack_size] = i;
+          loop_stack_size += 1;
+        }
+        break;
+      case BRAINFUCK_OP_LOOP_END:
+        valid = valid && loop_stack_size > 0 &&
+                loop_stack[loop_stack_size - 1] == (size_t)argument &&
+                program->instructions[argument].argument == (int32_t)i;
+        if (valid) {
+          loop_stack_size -= 1;
+        }
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    if (!valid) {
+      return false;
+    }
+  }
+  return loop_stack_size == 0;
+}
+
+/**
+ * @brief Store the low `width` bytes of a value in little-endian order.
+ * @param bytes The destination.
+ * @param value The value to store.
+ * @param width The number of bytes.
+ */
+void brainfuck_store_le(uint8_t *bytes, uint64_t value, size_t width) {
+  for (size_t i = 0; i < width; i += 1) {
+    bytes[i] = (uint8_t)(value >> (i * 8));
+  }
+}
+
+/**
+ * @brief Load a value of `width` bytes stored in little-endian order.
+ * @param bytes The source.
+ * @param width The number of bytes.
+ * @return The value.
+ */
+uint64_t brainfuck_load_le(const uint8_t *bytes, size_t width) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < width; i += 1) {
+    value |= (uint64_t)bytes[i] << (i * 8);
+  }
+  return value;
+}
+
+/**
+ * @brief Check whether instructions in memory are laid out exactly as in a
+ * compiled program file, so that a mapped file can be used in place.
+ * @return True on little-endian hosts with the usual structure layout.
+ */
+bool brainfuck_instruction_native() {
+  const uint16_t probe = 1;
+  uint8_t first = 0;
+  memcpy(&first, &probe, sizeof(first));
+  return first == 1 &&
+         sizeof(struct brainfuck_instruction) ==
+             BRAINFUCK_PROGRAM_INSTRUCTION_SIZE &&
+         offsetof(struct brainfuck_instruction, offset) == 4 &&
+         offsetof(struct brainfuck_instruction, argument) == 8;
+}
+
+/**
+ * @brief Check whether bytes start like a compiled program file.
+ * @param bytes The bytes to check.
+ * @param length The number of bytes.
+ * @return True if the bytes start with `BRAINFUCK_PROGRAM_MAGIC`.
+ */
+bool brainfuck_program_detect(const char *bytes, size_t length) {
+  return length >= 4 && memcmp(bytes, BRAINFUCK_PROGRAM_MAGIC, 4) == 0;
+}
+
+/**
+ * @brief Write a compiled program to a stream in the file format read by
+ * `brainfuck_program_read`.
+ * @param stream The stream to write to.
+ * @param program The program to write.
+ * @param header What the program was compiled from and for.
+ * @return True if the program is written successfully.
+ */
+bool brainfuck_program_write(FILE *stream,
+                             const struct brainfuck_program *program,
+                             const struct brainfuck_program_header *header) {
+  uint8_t bytes[BRAINFUCK_PROGRAM_HEADER_SIZE] = {0};
+  memcpy(bytes, BRAINFUCK_PROGRAM_MAGIC, 4);
+  brainfuck_store_le(bytes + 4, BRAINFUCK_PROGRAM_VERSION, 4);
+  brainfuck_store_le(bytes + 8, header->key, 8);
+  brainfuck_store_le(bytes + 16, program->size, 8);
+  brainfuck_store_le(bytes + 24, program->max_depth, 8);
+  brainfuck_store_le(bytes + 32, header->memory_size, 8);
+  bytes[40] = header->tape;
+  bytes[41] = header->optimization_level;
+  if (fwrite(bytes, sizeof(bytes), 1, stream) != 1) {
+    return false;
+  }
+  /* Instructions are encoded in chunks, which also zeroes their padding. */
+  uint8_t chunk[BRAINFUCK_PROGRAM_INSTRUCTION_SIZE * 256];
+  for (size_t i = 0; i < program->size; i += 256) {
+    size_t count = program->size - i < 256 ? program->size - i : 256;
+    memset(chunk, 0, sizeof(chunk));
+    for (size_t j = 0; j < count; j += 1) {
+      const struct brainfuck_instruction *instruction =
+          &program->instructions[i + j];
+      uint8_t *encoded = chunk + j * BRAINFUCK_PROGRAM_INSTRUCTION_SIZE;
+      encoded[0] = instruction->opcode;
+      brainfuck_store_le(encoded + 4, (uint32_t)instruction->offset, 4);
+      brainfuck_store_le(encoded + 8, (uint32_t)instruction->argument, 4);
+    }
+    if (fwrite(chunk, BRAINFUCK_PROGRAM_INSTRUCTION_SIZE, count, stream) !=
+        count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Read a compiled program from the bytes of a file. On hosts where
+ * `brainfuck_instruction_native` holds, the instructions are used in place,
+ * otherwise they are decoded into a copy. The program still has to be
+ * checked with `brainfuck_program_validate` before it is run.
+ * @param bytes The bytes of the file, aligned for an instruction.
+ * @param length The number of bytes.
+ * @param header Set to what the program was compiled from and for.
+ * @param program Set to the instructions.
+ * @param borrowed Set to true if the instructions are the bytes themselves,
+ * which must then outlive the program and not be freed with it.
+ * @return True if the bytes hold a compiled program of this version.
+ */
+bool brainfuck_program_read(const char *bytes, size_t length,
+                            struct brainfuck_program_header *header,
+                            struct brainfuck_program *program,
+                            bool *borrowed) {
+  const uint8_t *data = (const uint8_t *)bytes;
+  if (length < BRAINFUCK_PROGRAM_HEADER_SIZE ||
+      !brainfuck_program_detect(bytes, length) ||
+      brainfuck_load_le(data + 4, 4) != BRAINFUCK_PROGRAM_VERSION) {
+    return false;
+  }
+  uint64_t size = brainfuck_load_le(data + 16, 8);
+  uint64_t memory_size = brainfuck_load_le(data + 32, 8);
+  if ((length - BRAINFUCK_PROGRAM_HEADER_SIZE) %
+              BRAINFUCK_PROGRAM_INSTRUCTION_SIZE !=
+          0 ||
+      size != (length - BRAINFUCK_PROGRAM_HEADER_SIZE) /
+                  BRAINFUCK_PROGRAM_INSTRUCTION_SIZE ||
+      memory_size == 0 || memory_size > SIZE_MAX ||
+      data[40] > BRAINFUCK_TAPE_GUARD) {
+    return false;
+  }
+  header->key = brainfuck_load_le(data + 8, 8);
+  header->memory_size = (size_t)memory_size;
+  header->tape = data[40];
+  header->optimization_level = data[41];
+  program->size = (size_t)size;
+  program->capacity = (size_t)size;
+  program->max_depth = (size_t)brainfuck_load_le(data + 24, 8);
+  program->sources = NULL;
+  const uint8_t *encoded = data + BRAINFUCK_PROGRAM_HEADER_SIZE;
+  *borrowed = brainfuck_instruction_native();
+  if (*borrowed) {
+    program->instructions = (struct brainfuck_instruction *)encoded;
+    return true;
+  }
+  program->instructions =
+      malloc(sizeof(struct brainfuck_instruction) * (size == 0 ? 1 : size));
+  if (program->instructions == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < program->size; i += 1) {
+    program->instructions[i].opcode = encoded[0];
+    program->instructions[i].offset =
+        (int32_t)(uint32_t)brainfuck_load_le(encoded + 4, 4);
+    program->instructions[i].argument =
+        (int32_t)(uint32_t)brainfuck_load_le(encoded + 8, 4);
+    encoded += BRAINFUCK_PROGRAM_INSTRUCTION_SIZE;
+  }
+  return true;
+}
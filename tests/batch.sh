@@ -0,0 +1,9 @@
+# The outputs of a batch are written in the order of its manifest.
+printf ',[.,]' >"$SCRATCH/cat.bf"
+printf 'xyz\n' >"$SCRATCH/input"
+{
+  echo tests/hello_world.bf
+  echo "$SCRATCH/cat.bf $SCRATCH/input"
+  echo tests/idioms.bf
+} >"$SCRATCH/manifest"
+$IBF --eof 0 --jobs 2 --batch "$SCRATCH/manifest"
@@ -0,0 +1,11 @@
+# The second run of a program takes it from the cache the first one filled.
+XDG_CACHE_HOME=$SCRATCH
+export XDG_CACHE_HOME
+# A profile points at the source, so the profile engine does not cache.
+if [ "$ENGINE" = profile ]; then
+  IBF="$IBF --engine switch"
+fi
+for run in 1 2; do
+  $IBF --cache --stats tests/hello_world.bf 2>"$SCRATCH/stats" || exit 1
+  grep '^Cache:' "$SCRATCH/stats"
+done
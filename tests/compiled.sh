@@ -0,0 +1,11 @@
+# A compiled program runs on the tape it was compiled for, and a damaged one
+# or one on another tape of a batch is rejected.
+$IBF --compile -o "$SCRATCH/hello.bfc" tests/hello_world.bf || exit 1
+$IBF "$SCRATCH/hello.bfc" || exit 1
+$IBF --tape grow "$SCRATCH/hello.bfc" || exit 1
+head -c 40 "$SCRATCH/hello.bfc" >"$SCRATCH/damaged.bfc"
+$IBF "$SCRATCH/damaged.bfc"
+echo "damaged $?"
+echo "$SCRATCH/hello.bfc" >"$SCRATCH/manifest"
+$IBF --tape grow --batch "$SCRATCH/manifest"
+echo "batch $?"
@@ -0,0 +1,9 @@
+# The C translation of a program builds without warnings and prints the
+# same as running it.
+for program in hello_world idioms echo; do
+  $IBF --eof 0 --emit-c -o "$SCRATCH/$program.c" "tests/$program.bf" ||
+    exit 1
+  ${CC:-cc} -Wall -Wextra -Werror -o "$SCRATCH/$program" \
+    "$SCRATCH/$program.c" || exit 1
+  "$SCRATCH/$program" <tests/echo.in || exit 1
+done
@@ -0,0 +1,8 @@
+# What `,` leaves in the cell at the end of the input, for each mode but the
+# default, which stops the program.
+for eof in unchanged 0 255; do
+  printf 'a' | $IBF --eof "$eof" -c ',.,.' | od -An -v -tu1 | tr -s ' ' '\n' |
+    sed '/^$/d'
+done
+printf 'a' | $IBF -c ',.,.'
+echo " $?"
@@ -0,0 +1,12 @@
+# A folded start prints and leaves the same as running it, whether the
+# program runs straight away or from a compiled file.
+printf 'x' >"$SCRATCH/input"
+for fold in 1 10 100000; do
+  $IBF --fold "$fold" tests/hello_world.bf || exit 1
+  $IBF --fold "$fold" tests/idioms.bf || exit 1
+  $IBF --fold "$fold" --compile -o "$SCRATCH/folded.bfc" tests/idioms.bf ||
+    exit 1
+  $IBF "$SCRATCH/folded.bfc" || exit 1
+  $IBF --fold "$fold" -c '++++++++[>++++++++<-]>+.,.<+++++[>+<-]>.' \
+    <"$SCRATCH/input" || exit 1
+done
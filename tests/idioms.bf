@@ -0,0 +1,6 @@
+Multiply eight into two cells
+++++++++[->++++++++>+++++++++<<]>+.>.
+Clear downward and upward
+[-]++++++++++.[+]
+Scan left to the clear cell and right past the set ones
+>+>+>+[<]>[>]<<<<<.>++++++++++.
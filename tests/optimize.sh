@@ -0,0 +1,4 @@
+# Every optimization level runs the idioms the same.
+for level in 0 1 2; do
+  $IBF -O "$level" tests/idioms.bf || exit 1
+done
@@ -0,0 +1,4 @@
+Print ABC and DEF from nested loops
+++++++++[>++++++++<-]>+<
+++[>>+++[<.+>-]<<-]
+++++++++++.
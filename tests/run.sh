@@ -0,0 +1,47 @@
+#!/bin/sh
+# Run every test of tests/ on one engine: run.sh IBF ENGINE.
+#
+# A test is named by its expected output, NAME.out. NAME.bf is run with the
+# options of NAME.args, if any, before it, and NAME.in, if any, as its
+# input. NAME.sh is run instead when there is one, with IBF set to the
+# command to run, ENGINE to the engine and SCRATCH to a directory it may
+# write to. The exit status must be the one of NAME.status, 0 if there is
+# none, and the errors, leaving out the reports of the profile engine, the
+# ones of NAME.err if there is one.
+
+ibf=$1
+ENGINE=$2
+IBF="$ibf --engine $ENGINE"
+SCRATCH=$(mktemp -d) || exit 1
+export IBF ENGINE SCRATCH
+trap 'rm -rf "$SCRATCH"' EXIT
+
+for expected in tests/*.out; do
+  name=${expected%.out}
+  input=/dev/null
+  if [ -f "$name.in" ]; then
+    input=$name.in
+  fi
+  if [ -f "$name.sh" ]; then
+    sh "$name.sh" <"$input" >"$SCRATCH/out" 2>"$SCRATCH/err"
+  else
+    args=
+    if [ -f "$name.args" ]; then
+      args=$(cat "$name.args")
+    fi
+    eval "$IBF $args \"\$name.bf\"" <"$input" >"$SCRATCH/out" 2>"$SCRATCH/err"
+  fi
+  status=$?
+  sed '/^Profile: /,/^[A-Za-z]*Error: /{/^[A-Za-z]*Error: /!d;}' \
+    "$SCRATCH/err" >"$SCRATCH/errors"
+  want=0
+  if [ -f "$name.status" ]; then
+    want=$(cat "$name.status")
+  fi
+  if [ "$status" != "$want" ] || ! cmp -s "$SCRATCH/out" "$expected" ||
+     { [ -f "$name.err" ] && ! cmp -s "$SCRATCH/errors" "$name.err"; }; then
+    echo "FAIL $name ($ENGINE)"
+    exit 1
+  fi
+  rm -rf "$SCRATCH"/*
+done
@@ -0,0 +1,7 @@
+Scan left from the first cell around to the end of the tape
+<+<+<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++>>>+
+[<]>.
+Scan right by two from the end of the tape around to the start of it
+>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<<
+[>>]<.
+>>>>++++++++++.
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ibf.h"
+
+/**
+ * @brief The engines the check runs on, by their names on the command line.
+ */
+static const char *const brainfuck_snapshot_engines[] = {
+    [BRAINFUCK_ENGINE_SWITCH] = "switch",
+    [BRAINFUCK_ENGINE_THREADED] = "threaded",
+    [BRAINFUCK_ENGINE_JIT] = "jit",
+    [BRAINFUCK_ENGINE_PROFILE] = "profile",
+};
+
+/**
+ * @brief Run a line on a context, as the console does, and write what it
+ * prints.
+ * @param context The context of IBF, without handlers.
+ * @param line The line to run.
+ * @return True if the line is run successfully.
+ */
+bool brainfuck_snapshot_line(struct brainfuck_context *context,
+                             const char *line) {
+  char src[64];
+  snprintf(src, sizeof(src), "%s", line);
+  bool success = brainfuck_main(context, src);
+  size_t length = 0;
+  const uint8_t *output = brainfuck_context_output(context, &length);
+  fwrite(output, 1, length, stdout);
+  return success;
+}
+
+/**
+ * @brief Check that a snapshot brings back the tape, the memory pointer and
+ * a loop still being typed, on the engine named by the first argument.
+ */
+int main(int argc, char *argv[]) {
+  struct brainfuck_options options = brainfuck_options_default();
+  for (size_t i = 0; argc > 1 && i < sizeof(brainfuck_snapshot_engines) /
+                                         sizeof(brainfuck_snapshot_engines[0]);
+       i += 1) {
+    if (strcmp(argv[1], brainfuck_snapshot_engines[i]) == 0) {
+      options.engine = (uint8_t)i;
+    }
+  }
+  struct brainfuck_context *context =
+      brainfuck_context_new(NULL, NULL, NULL, &options);
+  if (context == NULL ||
+      !brainfuck_snapshot_line(context, "++++++++[>++++++++<-]>+.") ||
+      !brainfuck_snapshot_line(context, "[>+")) {
+    return EXIT_FAILURE;
+  }
+  struct brainfuck_snapshot *snapshot = brainfuck_snapshot_save(context);
+  /* The loop moves the letter to the next cell, which the restore clears
+   * again, so that the second run of the loop prints the same letter. */
+  bool success = snapshot != NULL &&
+                 brainfuck_snapshot_line(context, "<-]>.") &&
+                 brainfuck_snapshot_restore(context, snapshot) &&
+                 brainfuck_snapshot_line(context, "<-]>++.");
+  putchar('\n');
+  brainfuck_snapshot_free(snapshot);
+  brainfuck_context_free(context);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,3 @@
+# A snapshot brings back the tape and a loop still being typed, see
+# tests/snapshot.c.
+tests/snapshot "$ENGINE"
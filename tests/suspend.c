@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ibf.h"
+
+/**
+ * @brief The engines the check runs on, by their names on the command line.
+ */
+static const char *const brainfuck_suspend_engines[] = {
+    [BRAINFUCK_ENGINE_SWITCH] = "switch",
+    [BRAINFUCK_ENGINE_THREADED] = "threaded",
+    [BRAINFUCK_ENGINE_JIT] = "jit",
+    [BRAINFUCK_ENGINE_PROFILE] = "profile",
+};
+
+/**
+ * @brief The reasons a run is suspended, by `enum brainfuck_suspend`.
+ */
+static const char *const brainfuck_suspend_reasons[] = {
+    [BRAINFUCK_SUSPEND_NONE] = "none",
+    [BRAINFUCK_SUSPEND_STEPS] = "steps",
+    [BRAINFUCK_SUSPEND_TIMEOUT] = "timeout",
+    [BRAINFUCK_SUSPEND_INPUT] = "input",
+    [BRAINFUCK_SUSPEND_OUTPUT] = "output",
+};
+
+/**
+ * @brief Execute or resume a program, then print whether it finished, why
+ * it is suspended and the length of its output, with the output itself if
+ * it is short.
+ * @param context The context of IBF, without handlers.
+ * @param program The program to run.
+ * @param resume Whether the suspended run is resumed.
+ * @return True if the program is run to its end successfully.
+ */
+bool brainfuck_suspend_run(struct brainfuck_context *context,
+                           const struct brainfuck_program *program,
+                           bool resume) {
+  bool success = resume ? brainfuck_program_resume(context, program)
+                        : brainfuck_program_execute(context, program);
+  size_t length = 0;
+  const uint8_t *output = brainfuck_context_output(context, &length);
+  printf("%s %s %zu", success ? "done" : "suspended",
+         brainfuck_suspend_reasons[context->state->suspended], length);
+  if (length > 0 && length <= 16) {
+    printf(" %.*s", (int)length, (const char *)output);
+  }
+  putchar('\n');
+  return success;
+}
+
+/**
+ * @brief Compile a program made of a part repeated between two others.
+ * @param src The source code before the part, the part and after it.
+ * @param times The number of times the part is repeated.
+ * @param options The options of IBF.
+ * @return The program, or NULL if it cannot be compiled.
+ */
+struct brainfuck_program *brainfuck_suspend_program(
+    const char *const src[3], size_t times,
+    const struct brainfuck_options *options) {
+  size_t length = strlen(src[0]) + strlen(src[1]) * times + strlen(src[2]);
+  char *text = malloc(length + 1);
+  if (text == NULL) {
+    return NULL;
+  }
+  strcpy(text, src[0]);
+  for (size_t i = 0; i < times; i += 1) {
+    strcat(text, src[1]);
+  }
+  strcat(text, src[2]);
+  struct brainfuck_program *program =
+      brainfuck_program_compile(text, length, options);
+  free(text);
+  return program;
+}
+
+/**
+ * @brief Check that a run without handlers is suspended when `,` finds no
+ * input and when `.` finds the output buffer full, and that resuming it
+ * after feeding input or taking output runs it to its end, on the engine
+ * named by the first argument.
+ */
+int main(int argc, char *argv[]) {
+  struct brainfuck_options options = brainfuck_options_default();
+  for (size_t i = 0; argc > 1 && i < sizeof(brainfuck_suspend_engines) /
+                                         sizeof(brainfuck_suspend_engines[0]);
+       i += 1) {
+    if (strcmp(argv[1], brainfuck_suspend_engines[i]) == 0) {
+      options.engine = (uint8_t)i;
+    }
+  }
+  options.eof = BRAINFUCK_EOF_ZERO;
+  struct brainfuck_context *context =
+      brainfuck_context_new(NULL, NULL, NULL, &options);
+  /* Read bytes until the end of the input, writing each one plus one. */
+  const char *const echo[3] = {",[+.,", "", "]"};
+  /* Write 5000 letters, as one run of `.` and from a loop, more than the
+   * output buffer holds. */
+  const char *const run[3] = {"++++++++[>++++++++<-]>+", ".", ""};
+  const char *const loop[3] = {"++++++++[>++++++++<-]>+>", "+",
+                               "[>++++++++++++++++++++[<<.>>-]<-]"};
+  struct brainfuck_program *programs[] = {
+      brainfuck_suspend_program(echo, 0, &options),
+      brainfuck_suspend_program(run, 5000, &options),
+      brainfuck_suspend_program(loop, 250, &options),
+  };
+  if (context == NULL || programs[0] == NULL || programs[1] == NULL ||
+      programs[2] == NULL) {
+    return EXIT_FAILURE;
+  }
+  bool success = !brainfuck_suspend_run(context, programs[0], false) &&
+                 brainfuck_context_feed(context, (const uint8_t *)"ab", 2,
+                                        false) &&
+                 !brainfuck_suspend_run(context, programs[0], true) &&
+                 brainfuck_context_feed(context, (const uint8_t *)"c", 1,
+                                        true) &&
+                 brainfuck_suspend_run(context, programs[0], true);
+  for (size_t i = 1; success && i < 3; i += 1) {
+    brainfuck_context_reset(context);
+    success = !brainfuck_suspend_run(context, programs[i], false) &&
+              brainfuck_suspend_run(context, programs[i], true);
+  }
+  for (size_t i = 0; i < 3; i += 1) {
+    brainfuck_program_free(programs[i]);
+  }
+  brainfuck_context_free(context);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,3 @@
+# A run without handlers is suspended for input and for output and resumed
+# to its end, see tests/suspend.c.
+tests/suspend "$ENGINE"
@@ -0,0 +1 @@
+Close a loop twice: +[-]]
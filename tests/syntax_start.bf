@@ -0,0 +1 @@
+Leave a loop open: [+[-]
@@ -0,0 +1,2 @@
+Run off the start of the tape
+<+.
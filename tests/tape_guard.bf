@@ -0,0 +1,2 @@
+Scan a guarded tape
+>+>+>+>+[<]>[>]<.
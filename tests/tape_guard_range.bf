@@ -0,0 +1,2 @@
+Run off the end of the tape
++[>+]
@@ -0,0 +1,2 @@
+Wrap around to the last cell
+<+.
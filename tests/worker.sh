@@ -0,0 +1,31 @@
+# A worker answers a program with its key, a job on that key with its
+# status, counts and output, and a message of no known kind, or with no
+# kind at all, with an error.
+# The key is taken from a first worker, and the time of the job is left out.
+program=',[+.,]'
+
+length() {
+  printf "\\$(printf %03o "$1")\\000\\000\\000"
+}
+
+load() {
+  length $((1 + ${#program}))
+  printf 'P%s' "$program"
+}
+
+bytes() {
+  od -An -v -to1 | tr -s ' \n' ' ' | sed 's/^ //;s/ $//;s/ /\\/g;s/^/\\/'
+}
+
+key=$(load | $IBF --eof 0 --worker | tail -c +6 | bytes)
+{
+  load
+  length 28
+  printf "J$key"
+  printf '\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000'
+  printf 'abc'
+  length 1
+  printf 'X'
+  length 0
+} | $IBF --eof 0 --worker | od -An -v -tu1 | tr -s ' ' '\n' | sed '/^$/d' |
+  sed '6,13d;44,51d'